@@ -1,6 +1,7 @@
 #include <iostream>
 #include "rtc_base/ssl_adapter.h"
 #include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
 // #include "rtc_base/thread.h"
 
 // #include "api/peer_connection_interface.h"
@@ -13,6 +14,8 @@
 #include "ui/widg.h"
 #include "module/pushclient.h"
 #include "module/signaling_client.h"
+#include "module/async_log_sink.h"
+#include "module/capture_dump.h"
 #include <QApplication>
 #include <QUrl>
 
@@ -23,7 +26,6 @@
 
 #include <X11/Xlib.h>
 #include <thread>
-#include <fstream>
 
 class MyDesktopCapturerCallback : public webrtc::DesktopCapturer::Callback
 {
@@ -36,24 +38,22 @@ public:
   void OnCaptureResult(webrtc::DesktopCapturer::Result result,
                        std::unique_ptr<webrtc::DesktopFrame> frame) override
   {
-    std::ofstream yuvfile("frame.yuv", std::ios::binary);
     if (result == webrtc::DesktopCapturer::Result::SUCCESS)
     {
       std::cout << "[Callback] Frame captured: "
                 << frame->size().width() << "x" << frame->size().height() << "format" << frame->pixel_format() << std::endl;
-      // 保存为 YUV 文件
-      int width = frame->size().width();
-      int height = frame->size().height();
-      const uint8_t *data = frame->data();
-      int stride = frame->stride();
-      yuvfile.write(reinterpret_cast<const char *>(data), stride * height);
-      yuvfile.close();
+      // 写入环形转储文件（带尺寸/stride/时间戳/变化区域），用 capture_dump_tool 查看或导出
+      // capture_time_ms 是采集耗时，时间戳回推到采集开始
+      dump_.Write(*frame, webrtc::TimeMicros() - frame->capture_time_ms() * 1000);
     }
     else
     {
       std::cout << "[Callback] Capture failed with result: " << static_cast<int>(result) << std::endl;
     }
   }
+
+private:
+  CaptureDumpWriter dump_{"frame.cdmp", 64};
 };
 
 int main(int argc, char *argv[])
@@ -65,7 +65,8 @@ int main(int argc, char *argv[])
 
 #endif
 
-  webrtc::LogMessage::SetLogToStderr(true);
+  // 日志走异步 Sink，避免 stderr 写入阻塞信令/网络线程
+  AsyncLogSink::Instance().Start(webrtc::LS_INFO);
   // webrtc::LogMessage::LogToDebug(webrtc::LS_INFO); // 或者 rtc::LS_INFO
   std::cout << "[webrtc-smoke] Start" << std::endl;
 
@@ -142,5 +143,6 @@ std::this_thread::sleep_for(std::chrono::seconds(1));
   std::cout << "Hello, World!" << std::endl;
   a.exec();
   webrtc::CleanupSSL();
+  AsyncLogSink::Instance().Stop();
   return 0;
 }
\ No newline at end of file
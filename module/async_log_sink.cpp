@@ -0,0 +1,284 @@
+#include "async_log_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "rtc_base/time_utils.h"
+
+namespace
+{
+    bool AllowInWindow(std::atomic<int64_t> &window_start_ms, std::atomic<int> &count,
+                       int max_per_second, int64_t now_ms, bool *window_reset)
+    {
+        int64_t start = window_start_ms.load(std::memory_order_relaxed);
+        if (now_ms - start >= 1000 &&
+            window_start_ms.compare_exchange_strong(start, now_ms, std::memory_order_relaxed))
+        {
+            count.store(0, std::memory_order_relaxed);
+            if (window_reset)
+                *window_reset = true;
+        }
+        return count.fetch_add(1, std::memory_order_relaxed) < max_per_second;
+    }
+
+    const char *SeverityTag(webrtc::LoggingSeverity sev)
+    {
+        switch (sev)
+        {
+        case webrtc::LS_VERBOSE:
+            return "V";
+        case webrtc::LS_INFO:
+            return "I";
+        case webrtc::LS_WARNING:
+            return "W";
+        case webrtc::LS_ERROR:
+            return "E";
+        default:
+            return "?";
+        }
+    }
+} // namespace
+
+bool CallSiteRateLimiter::Allow(int max_per_second)
+{
+    if (max_per_second <= 0)
+        return true;
+    return AllowInWindow(window_start_ms_, count_, max_per_second, webrtc::TimeMillis(), nullptr);
+}
+
+AsyncLogSink &AsyncLogSink::Instance()
+{
+    static AsyncLogSink sink;
+    return sink;
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+    Stop();
+}
+
+void AsyncLogSink::Start(webrtc::LoggingSeverity min_severity)
+{
+    if (running_.exchange(true))
+        return;
+
+    for (size_t i = 0; i < kSlotCount; ++i)
+        (*slots_)[i].seq.store(i, std::memory_order_relaxed);
+    enqueue_pos_.store(0);
+    dequeue_pos_ = 0;
+
+    min_severity_.store(min_severity);
+    writer_thread_ = std::thread(&AsyncLogSink::WriterLoop, this);
+
+    // 关掉 LogMessage 自带的同步 stderr 输出，全部走本 Sink
+    saved_debug_severity_ = webrtc::LogMessage::GetLogToDebug();
+    webrtc::LogMessage::SetLogToStderr(false);
+    webrtc::LogMessage::LogToDebug(webrtc::LS_NONE);
+    webrtc::LogMessage::AddLogToStream(this, min_severity);
+}
+
+void AsyncLogSink::Stop()
+{
+    if (!running_.exchange(false))
+        return;
+    webrtc::LogMessage::RemoveLogToStream(this);
+    // 恢复同步输出，Stop 之后的日志仍然可见
+    webrtc::LogMessage::LogToDebug(saved_debug_severity_);
+    webrtc::LogMessage::SetLogToStderr(true);
+    if (writer_thread_.joinable())
+        writer_thread_.join();
+}
+
+void AsyncLogSink::SetMinSeverity(webrtc::LoggingSeverity severity)
+{
+    min_severity_.store(severity);
+    if (running_.load())
+    {
+        // LogMessage 以注册时的级别做过滤，重新注册才能让低级别日志在源头被跳过
+        webrtc::LogMessage::RemoveLogToStream(this);
+        webrtc::LogMessage::AddLogToStream(this, severity);
+    }
+}
+
+bool AsyncLogSink::SeverityFromString(const std::string &name, webrtc::LoggingSeverity *out)
+{
+    static const std::pair<const char *, webrtc::LoggingSeverity> kNames[] = {
+        {"verbose", webrtc::LS_VERBOSE}, {"info", webrtc::LS_INFO}, {"warning", webrtc::LS_WARNING},
+        {"error", webrtc::LS_ERROR},     {"none", webrtc::LS_NONE},
+    };
+    for (const auto &[n, sev] : kNames)
+    {
+        if (name == n)
+        {
+            *out = sev;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsyncLogSink::AllowCallSite(const char *file, int line, int *suppressed_before)
+{
+    const int limit = rate_limit_per_sec_.load(std::memory_order_relaxed);
+    if (limit <= 0)
+        return true;
+
+    // 文件名来自 __FILE__ 字面量，地址稳定，直接用指针+行号做哈希；冲突的调用点共享配额
+    const size_t h = (reinterpret_cast<uintptr_t>(file) >> 3) ^ (static_cast<size_t>(line) * 2654435761u);
+    RateBucket &b = buckets_[h & (kRateBuckets - 1)];
+
+    bool window_reset = false;
+    const bool allowed = AllowInWindow(b.window_start_ms, b.count, limit, webrtc::TimeMillis(), &window_reset);
+    if (window_reset)
+        *suppressed_before = b.suppressed.exchange(0, std::memory_order_relaxed);
+    if (!allowed)
+    {
+        b.suppressed.fetch_add(1, std::memory_order_relaxed);
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return allowed;
+}
+
+void AsyncLogSink::OnLogMessage(const webrtc::LogLineRef &line)
+{
+    const webrtc::LoggingSeverity sev = line.severity();
+    if (sev < min_severity_.load(std::memory_order_relaxed))
+        return;
+
+    const absl::string_view file = line.filename();
+    int suppressed_before = 0;
+    if (sev < webrtc::LS_ERROR && !AllowCallSite(file.data(), line.line(), &suppressed_before))
+        return;
+
+    char buf[kSlotBytes];
+    const absl::string_view msg = line.message();
+    int n = snprintf(buf, sizeof(buf), "[%lld] [%s] %.*s:%d: ",
+                     static_cast<long long>(webrtc::TimeMillis()), SeverityTag(sev),
+                     static_cast<int>(file.size()), file.data(), line.line());
+    if (n < 0)
+        return;
+    size_t len = std::min(static_cast<size_t>(n), sizeof(buf) - 1);
+    if (suppressed_before > 0 && len < sizeof(buf) - 1)
+    {
+        n = snprintf(buf + len, sizeof(buf) - len, "(%d suppressed) ", suppressed_before);
+        if (n > 0)
+            len = std::min(len + n, sizeof(buf) - 1);
+    }
+
+    // 超长的消息（如完整 SDP）截断，以 "...\n" 结尾；前缀（很长的文件路径）占满时也截断前缀，至少留出 "..."
+    len = std::min(len, sizeof(buf) - 4);
+    const size_t room = sizeof(buf) - 1 - len;
+    size_t body = msg.size();
+    while (body > 0 && (msg[body - 1] == '\n' || msg[body - 1] == '\r'))
+        --body;
+    if (body <= room)
+    {
+        memcpy(buf + len, msg.data(), body);
+        len += body;
+    }
+    else
+    {
+        memcpy(buf + len, msg.data(), room - 3);
+        memcpy(buf + len + room - 3, "...", 3);
+        len += room;
+    }
+    buf[len++] = '\n';
+    Push(buf, len);
+}
+
+void AsyncLogSink::OnLogMessage(const std::string &message)
+{
+    char buf[kSlotBytes];
+    size_t len = std::min(message.size(), sizeof(buf) - 1);
+    memcpy(buf, message.data(), len);
+    if (len == 0 || buf[len - 1] != '\n')
+        buf[len++] = '\n';
+    Push(buf, len);
+}
+
+void AsyncLogSink::Push(const char *data, size_t len)
+{
+    if (!running_.load(std::memory_order_relaxed))
+        return;
+
+    // 有界多生产者/单消费者队列：每个槽位带序号，生产者 CAS 抢占写位置
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    for (;;)
+    {
+        slot = &(*slots_)[pos & (kSlotCount - 1)];
+        const size_t seq = slot->seq.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // 缓冲满：丢弃而不是阻塞调用线程
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    len = std::min(len, kSlotBytes);
+    memcpy(slot->text, data, len);
+    slot->len = static_cast<uint16_t>(len);
+    slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+size_t AsyncLogSink::Drain(std::string &out)
+{
+    size_t n = 0;
+    for (;;)
+    {
+        Slot &slot = (*slots_)[dequeue_pos_ & (kSlotCount - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != dequeue_pos_ + 1)
+            break;
+        out.append(slot.text, slot.len);
+        slot.seq.store(dequeue_pos_ + kSlotCount, std::memory_order_release);
+        ++dequeue_pos_;
+        ++n;
+    }
+    return n;
+}
+
+void AsyncLogSink::WriterLoop()
+{
+    std::string out;
+    out.reserve(kSlotCount * 128);
+    uint64_t reported_dropped = 0;
+    for (;;)
+    {
+        const bool running = running_.load();
+        out.clear();
+        const size_t n = Drain(out);
+
+        const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped)
+        {
+            out += "[async-log] dropped " + std::to_string(dropped - reported_dropped) + " lines (buffer full)\n";
+            reported_dropped = dropped;
+        }
+
+        if (!out.empty())
+        {
+            // 一次大块写入，代替每条日志一次 write
+            fwrite(out.data(), 1, out.size(), stderr);
+            fflush(stderr);
+        }
+        if (n == 0)
+        {
+            if (!running)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "rtc_base/logging.h"
+
+// 异步日志 Sink：日志线程只把格式化后的文本写进无锁环形缓冲，
+// 由后台线程批量写到 stderr，避免信令/网络线程阻塞在 stderr 写入上。
+// 使用方式：
+//   AsyncLogSink::Instance().Start(webrtc::LS_INFO);
+//   ...
+//   AsyncLogSink::Instance().Stop();
+class AsyncLogSink : public webrtc::LogSink
+{
+public:
+    static AsyncLogSink &Instance();
+
+    // 注册到 webrtc::LogMessage 并启动后台写线程
+    void Start(webrtc::LoggingSeverity min_severity = webrtc::LS_INFO);
+    // 注销并把缓冲中剩余日志全部写出
+    void Stop();
+
+    // 运行时调整日志级别（同时更新 LogMessage 的过滤，低于级别的日志不会被格式化）
+    void SetMinSeverity(webrtc::LoggingSeverity severity);
+    webrtc::LoggingSeverity GetMinSeverity() const { return min_severity_.load(); }
+    // "verbose" / "info" / "warning" / "error" / "none"，无法识别时返回 false
+    static bool SeverityFromString(const std::string &name, webrtc::LoggingSeverity *out);
+
+    // 每个调用点（文件+行号）每秒最多输出多少条，0 表示不限制；LS_ERROR 不受限制
+    void SetRateLimitPerSecond(int max_per_second) { rate_limit_per_sec_.store(max_per_second); }
+
+    // 统计：因缓冲满丢弃 / 因限流丢弃的条数
+    uint64_t DroppedCount() const { return dropped_.load(); }
+    uint64_t SuppressedCount() const { return suppressed_.load(); }
+
+    // --- LogSink 接口 ---
+    void OnLogMessage(const webrtc::LogLineRef &line) override;
+    void OnLogMessage(const std::string &message) override;
+
+private:
+    AsyncLogSink() = default;
+    ~AsyncLogSink() override;
+
+    static constexpr size_t kSlotCount = 1024; // 必须是 2 的幂
+    static constexpr size_t kSlotBytes = 480;
+    static constexpr size_t kRateBuckets = 256;
+
+    struct Slot
+    {
+        std::atomic<size_t> seq{0};
+        uint16_t len{0};
+        char text[kSlotBytes];
+    };
+
+    struct RateBucket
+    {
+        std::atomic<int64_t> window_start_ms{0};
+        std::atomic<int> count{0};
+        std::atomic<int> suppressed{0};
+    };
+
+    // 返回 false 表示本条被限流；suppressed_before 返回上一个窗口被压掉的条数
+    bool AllowCallSite(const char *file, int line, int *suppressed_before);
+    // 多生产者入队，缓冲满时直接丢弃
+    void Push(const char *data, size_t len);
+    void WriterLoop();
+    size_t Drain(std::string &out);
+
+    std::unique_ptr<std::array<Slot, kSlotCount>> slots_{std::make_unique<std::array<Slot, kSlotCount>>()};
+    std::atomic<size_t> enqueue_pos_{0};
+    size_t dequeue_pos_{0}; // 仅后台线程访问
+
+    std::array<RateBucket, kRateBuckets> buckets_{};
+
+    std::atomic<webrtc::LoggingSeverity> min_severity_{webrtc::LS_INFO};
+    std::atomic<int> rate_limit_per_sec_{20};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> suppressed_{0};
+
+    std::atomic<bool> running_{false};
+    std::thread writer_thread_;
+    // Start 前的同步输出级别，Stop 时恢复
+    webrtc::LoggingSeverity saved_debug_severity_{webrtc::LS_INFO};
+};
+
+// 单个调用点的计数窗口，配合 RTC_LOG_EVERY_SEC 使用
+class CallSiteRateLimiter
+{
+public:
+    bool Allow(int max_per_second);
+
+private:
+    std::atomic<int64_t> window_start_ms_{0};
+    std::atomic<int> count_{0};
+};
+
+// 高频调用点的本地限流：每秒最多 n 条，超出部分直接跳过（连格式化都不做）
+#define RTC_LOG_EVERY_SEC(sev, n)                                              \
+    if (!([]() -> CallSiteRateLimiter & { static CallSiteRateLimiter l; return l; }().Allow(n))) \
+    {                                                                          \
+    }                                                                          \
+    else                                                                       \
+        RTC_LOG(sev)
@@ -0,0 +1,93 @@
+#include "bitrate_controller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+AdaptiveBitrateController::AdaptiveBitrateController(const BitratePolicy &policy, int max_bitrate_bps, int max_framerate)
+    : policy_(policy),
+      max_bitrate_bps_(std::max(policy.min_bitrate_bps, max_bitrate_bps)),
+      max_framerate_(std::max(1, max_framerate)),
+      target_bps_(max_bitrate_bps_)
+{
+    current_ = LimitsForBitrate(max_bitrate_bps_, ContentMode::kDetailed);
+}
+
+std::optional<EncodingLimits> AdaptiveBitrateController::OnSample(const NetworkSample &sample, ContentMode mode,
+                                                                  std::string *reason)
+{
+    std::ostringstream why;
+    if (sample.loss_fraction > policy_.high_loss)
+    {
+        target_bps_ *= policy_.decrease_factor;
+        why << "loss " << sample.loss_fraction;
+    }
+    else if (sample.rtt_ms > policy_.high_rtt_ms)
+    {
+        target_bps_ *= policy_.decrease_factor;
+        why << "rtt " << sample.rtt_ms << "ms";
+    }
+    else if (sample.loss_fraction < policy_.low_loss)
+    {
+        target_bps_ *= policy_.increase_factor;
+        why << "probe up";
+    }
+    else
+    {
+        why << "hold";
+    }
+
+    if (sample.available_outgoing_bps > 0)
+    {
+        const double cap = sample.available_outgoing_bps * policy_.headroom;
+        if (target_bps_ > cap)
+        {
+            target_bps_ = cap;
+            why << ", capped by available " << sample.available_outgoing_bps << "bps";
+        }
+    }
+    target_bps_ = std::clamp(target_bps_, static_cast<double>(policy_.min_bitrate_bps),
+                             static_cast<double>(max_bitrate_bps_));
+
+    EncodingLimits next = LimitsForBitrate(static_cast<int>(target_bps_), mode);
+    // 码率变化小于 5% 且帧率/分辨率不变时不重复下发
+    const bool small_change = std::abs(next.max_bitrate_bps - current_.max_bitrate_bps) < current_.max_bitrate_bps / 20 &&
+                              next.max_framerate == current_.max_framerate &&
+                              next.scale_down_by == current_.scale_down_by;
+    if (small_change)
+        return std::nullopt;
+
+    current_ = next;
+    if (reason)
+        *reason = why.str();
+    return next;
+}
+
+EncodingLimits AdaptiveBitrateController::LimitsForBitrate(int bitrate_bps, ContentMode mode) const
+{
+    EncodingLimits limits;
+    limits.max_bitrate_bps = bitrate_bps;
+    limits.max_framerate = max_framerate_;
+    limits.scale_down_by = 1.0;
+
+    // ratio >= 0.5 时保持原样；再往下先降一个维度，低于 0.25 时两个都降
+    const double ratio = static_cast<double>(bitrate_bps) / max_bitrate_bps_;
+    if (ratio >= 0.5)
+        return limits;
+
+    const int reduced_fps = std::max(policy_.min_framerate, static_cast<int>(std::lround(max_framerate_ * ratio * 2)));
+    const double reduced_scale = std::min(policy_.max_scale_down, std::sqrt(0.5 / ratio));
+    const bool prefer_resolution = (mode != ContentMode::kFluid);
+    if (ratio >= 0.25)
+    {
+        if (prefer_resolution)
+            limits.max_framerate = reduced_fps;
+        else
+            limits.scale_down_by = reduced_scale;
+        return limits;
+    }
+
+    limits.max_framerate = prefer_resolution ? reduced_fps : std::max(policy_.min_framerate, max_framerate_ / 2);
+    limits.scale_down_by = prefer_resolution ? std::min(policy_.max_scale_down, std::sqrt(0.25 / ratio)) : reduced_scale;
+    return limits;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <optional>
+#include <string>
+
+#include "video_send_config.h"
+
+// 一次 getStats 得到的网络状况
+struct NetworkSample
+{
+    double rtt_ms{0};              // candidate-pair / remote-inbound 的 RTT
+    double loss_fraction{0};       // remote-inbound 的 fraction_lost（0~1）
+    int available_outgoing_bps{0}; // candidate-pair 的 available_outgoing_bitrate，0 表示未知
+};
+
+// 码率控制器给出的编码上限，应用到 RtpSender 的 encodings 上
+struct EncodingLimits
+{
+    int max_bitrate_bps{0};    // 0 表示不限制（使用配置值）
+    int max_framerate{0};      // 0 表示不限制
+    double scale_down_by{1.0}; // 在配置/内容模式缩放基础上额外缩小的倍数
+};
+
+// 每个推流客户端一个：根据 RTT/丢包/可用带宽调整码率上限，码率不足时再按内容模式
+// 决定先降帧率（text/detailed）还是先降分辨率（fluid）。
+class AdaptiveBitrateController
+{
+public:
+    AdaptiveBitrateController(const BitratePolicy &policy, int max_bitrate_bps, int max_framerate);
+
+    // 每个统计周期调用一次；限制发生明显变化时返回新的值，reason 为决策原因（用于日志）
+    std::optional<EncodingLimits> OnSample(const NetworkSample &sample, ContentMode mode, std::string *reason);
+
+    const EncodingLimits &current() const { return current_; }
+    const BitratePolicy &policy() const { return policy_; }
+
+private:
+    EncodingLimits LimitsForBitrate(int bitrate_bps, ContentMode mode) const;
+
+    BitratePolicy policy_;
+    int max_bitrate_bps_;
+    int max_framerate_;
+    double target_bps_;
+    EncodingLimits current_;
+};
@@ -0,0 +1,215 @@
+#include "capture_dump.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "modules/desktop_capture/desktop_frame.h"
+#include "modules/desktop_capture/desktop_region.h"
+#include "rtc_base/logging.h"
+
+namespace
+{
+    size_t AlignUp(size_t v, size_t align)
+    {
+        return (v + align - 1) / align * align;
+    }
+
+    // 文件可能被截断或损坏，回放前确认尺寸、像素大小和变化区域数量都自洽，避免越界读
+    bool IsValidFrameHeader(const CaptureDumpFrameHeader &header, uint64_t slot_size)
+    {
+        if (header.sequence == 0 || header.width <= 0 || header.height <= 0)
+            return false;
+        if (header.data_size > slot_size - sizeof(CaptureDumpFrameHeader))
+            return false;
+        if (uint64_t{static_cast<uint32_t>(header.width)} * 4 * static_cast<uint32_t>(header.height) != header.data_size)
+            return false;
+        return header.rect_count >= 0 && header.rect_count <= kCaptureDumpMaxRects;
+    }
+} // namespace
+
+CaptureDumpWriter::CaptureDumpWriter(std::string path, int slot_count)
+    : path_(std::move(path)), slot_count_(std::max(1, slot_count))
+{
+}
+
+CaptureDumpWriter::~CaptureDumpWriter()
+{
+    Close();
+}
+
+bool CaptureDumpWriter::Open(size_t frame_bytes)
+{
+    slot_size_ = AlignUp(sizeof(CaptureDumpFrameHeader) + frame_bytes, kCaptureDumpPageSize);
+    map_size_ = kCaptureDumpPageSize + slot_size_ * slot_count_;
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+    {
+        RTC_LOG(LS_ERROR) << "[CAPTURE-DUMP] open " << path_ << " failed: " << strerror(errno);
+        return false;
+    }
+    // 一次性分配好磁盘空间，写帧时不会再扩展文件
+    const int err = posix_fallocate(fd_, 0, static_cast<off_t>(map_size_));
+    if (err != 0)
+    {
+        RTC_LOG(LS_ERROR) << "[CAPTURE-DUMP] allocate " << map_size_ << " bytes failed: " << strerror(err);
+        Close();
+        return false;
+    }
+    void *map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED)
+    {
+        RTC_LOG(LS_ERROR) << "[CAPTURE-DUMP] mmap failed: " << strerror(errno);
+        map_ = nullptr;
+        Close();
+        return false;
+    }
+    map_ = static_cast<uint8_t *>(map);
+    // 顺序写、不回读
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+    auto *header = reinterpret_cast<CaptureDumpFileHeader *>(map_);
+    header->magic = kCaptureDumpMagic;
+    header->version = kCaptureDumpVersion;
+    header->slot_count = static_cast<uint32_t>(slot_count_);
+    header->slot_size = slot_size_;
+    header->frames_written = 0;
+    RTC_LOG(LS_INFO) << "[CAPTURE-DUMP] " << path_ << ": " << slot_count_ << " slots x " << slot_size_ << " bytes";
+    return true;
+}
+
+void CaptureDumpWriter::Close()
+{
+    if (map_)
+    {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool CaptureDumpWriter::Write(const webrtc::DesktopFrame &frame, int64_t capture_time_us)
+{
+    const int width = frame.size().width();
+    const int height = frame.size().height();
+    const size_t row_bytes = static_cast<size_t>(width) * webrtc::DesktopFrame::kBytesPerPixel;
+    const size_t data_size = row_bytes * height;
+    if (failed_)
+        return false;
+    if (!map_ && !Open(data_size))
+    {
+        failed_ = true;
+        return false;
+    }
+    if (sizeof(CaptureDumpFrameHeader) + data_size > slot_size_)
+    {
+        skipped_++;
+        return false;
+    }
+
+    uint8_t *slot = map_ + kCaptureDumpPageSize + slot_size_ * (sequence_ % slot_count_);
+    auto *header = reinterpret_cast<CaptureDumpFrameHeader *>(slot);
+    // 先作废 slot，写到一半中断时读端能识别出来
+    header->sequence = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    header->capture_time_us = capture_time_us;
+    header->capture_cost_ms = frame.capture_time_ms();
+    header->width = width;
+    header->height = height;
+    header->src_stride = frame.stride();
+    header->pixel_format = frame.pixel_format();
+    header->data_size = data_size;
+
+    int rects = 0;
+    webrtc::DesktopRect bounds;
+    for (webrtc::DesktopRegion::Iterator it(frame.updated_region()); !it.IsAtEnd(); it.Advance(), ++rects)
+    {
+        const webrtc::DesktopRect &r = it.rect();
+        if (rects < kCaptureDumpMaxRects)
+            header->rects[rects] = {r.left(), r.top(), r.right(), r.bottom()};
+        bounds.UnionWith(r);
+    }
+    header->rects_truncated = rects > kCaptureDumpMaxRects;
+    if (header->rects_truncated)
+    {
+        header->rects[0] = {bounds.left(), bounds.top(), bounds.right(), bounds.bottom()};
+        header->rect_count = 1;
+    }
+    else
+    {
+        header->rect_count = rects;
+    }
+
+    uint8_t *dst = slot + sizeof(CaptureDumpFrameHeader);
+    if (static_cast<size_t>(frame.stride()) == row_bytes)
+    {
+        std::memcpy(dst, frame.data(), data_size);
+    }
+    else
+    {
+        for (int y = 0; y < height; ++y)
+            std::memcpy(dst + row_bytes * y, frame.data() + static_cast<size_t>(frame.stride()) * y, row_bytes);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    header->sequence = ++sequence_;
+    reinterpret_cast<CaptureDumpFileHeader *>(map_)->frames_written = sequence_;
+    return true;
+}
+
+CaptureDumpReader::~CaptureDumpReader()
+{
+    if (map_)
+        munmap(const_cast<uint8_t *>(map_), map_size_);
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+bool CaptureDumpReader::Open(const std::string &path)
+{
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        return false;
+    struct stat st{};
+    if (fstat(fd_, &st) != 0 || static_cast<size_t>(st.st_size) < kCaptureDumpPageSize)
+        return false;
+    map_size_ = static_cast<size_t>(st.st_size);
+    // 私有可写映射：回放时帧直接指向映射内容，下游误写也只会触发写时复制，不会改到文件
+    void *map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd_, 0);
+    if (map == MAP_FAILED)
+        return false;
+    map_ = static_cast<const uint8_t *>(map);
+
+    file_header_ = reinterpret_cast<const CaptureDumpFileHeader *>(map_);
+    if (file_header_->magic != kCaptureDumpMagic || file_header_->version != kCaptureDumpVersion ||
+        file_header_->slot_size < sizeof(CaptureDumpFrameHeader) ||
+        file_header_->slot_count > (map_size_ - kCaptureDumpPageSize) / file_header_->slot_size)
+    {
+        file_header_ = nullptr;
+        return false;
+    }
+
+    frames_.clear();
+    for (uint32_t i = 0; i < file_header_->slot_count; ++i)
+    {
+        const uint8_t *slot = map_ + kCaptureDumpPageSize + file_header_->slot_size * i;
+        const auto *header = reinterpret_cast<const CaptureDumpFrameHeader *>(slot);
+        if (!IsValidFrameHeader(*header, file_header_->slot_size))
+            continue;
+        frames_.push_back({header, slot + sizeof(CaptureDumpFrameHeader)});
+    }
+    std::sort(frames_.begin(), frames_.end(), [](const Frame &a, const Frame &b)
+              { return a.header->sequence < b.header->sequence; });
+    return true;
+}
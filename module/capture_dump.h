@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace webrtc
+{
+    class DesktopFrame;
+}
+
+// 原始采集转储文件格式（小端，所有结构按 8 字节对齐）：
+//   [CaptureDumpFileHeader，占 kCaptureDumpPageSize]
+//   [slot 0][slot 1]...[slot N-1]，每个 slot 大小为 slot_size（页对齐）
+//   slot = [CaptureDumpFrameHeader][紧凑排列的像素，每行 width*4 字节]
+// 文件按环形写入，只保留最近 N 帧；按 sequence 排序即为采集顺序，sequence 为 0 的 slot 无效。
+constexpr uint32_t kCaptureDumpMagic = 0x504d4443; // "CDMP"
+constexpr uint32_t kCaptureDumpVersion = 1;
+constexpr size_t kCaptureDumpPageSize = 4096;
+constexpr int kCaptureDumpMaxRects = 64;
+
+struct CaptureDumpFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t slot_size;
+    uint64_t frames_written; // 累计写入帧数（含被覆盖的）
+};
+
+struct CaptureDumpRect
+{
+    int32_t left, top, right, bottom;
+};
+
+struct CaptureDumpFrameHeader
+{
+    uint64_t sequence;        // 从 1 开始，写完像素后才写入，0 表示无效/写了一半
+    int64_t capture_time_us;  // 采集开始时刻（rtc::TimeMicros 时钟，与 VideoFrame 时间戳一致）
+    int64_t capture_cost_ms;  // 采集本身耗时（DesktopFrame::capture_time_ms）
+    int32_t width;
+    int32_t height;
+    int32_t src_stride;       // 原始 DesktopFrame 的 stride
+    uint32_t pixel_format;    // FourCC，目前都是 'ARGB'（内存顺序 BGRA）
+    int32_t rect_count;       // 变化区域数量，超过 kCaptureDumpMaxRects 时只保存外接矩形
+    int32_t rects_truncated;
+    uint64_t data_size;       // 像素字节数 = width * 4 * height
+    CaptureDumpRect rects[kCaptureDumpMaxRects];
+};
+
+// 转换线程调用（CapturerTrackSource::DumpFrame，由 dump_mutex_ 保护）：第一帧时按其大小预分配并 mmap 整个文件，
+// 之后每帧只是一次 memcpy，由内核异步回写，不在流水线线程上做同步文件 IO。
+class CaptureDumpWriter
+{
+public:
+    CaptureDumpWriter(std::string path, int slot_count);
+    ~CaptureDumpWriter();
+
+    CaptureDumpWriter(const CaptureDumpWriter &) = delete;
+    CaptureDumpWriter &operator=(const CaptureDumpWriter &) = delete;
+
+    // 比第一帧大的帧（分辨率变大）放不下，跳过并计数
+    bool Write(const webrtc::DesktopFrame &frame, int64_t capture_time_us);
+
+    uint64_t frames_written() const { return sequence_; }
+    uint64_t frames_skipped() const { return skipped_; }
+
+private:
+    bool Open(size_t frame_bytes);
+    void Close();
+
+    const std::string path_;
+    const int slot_count_;
+    int fd_{-1};
+    uint8_t *map_{nullptr};
+    size_t map_size_{0};
+    size_t slot_size_{0};
+    uint64_t sequence_{0};
+    uint64_t skipped_{0};
+    bool failed_{false};
+};
+
+// 读取转储文件（mmap，不修改文件），frames() 按采集顺序排列
+class CaptureDumpReader
+{
+public:
+    struct Frame
+    {
+        const CaptureDumpFrameHeader *header;
+        const uint8_t *data; // 紧凑排列，stride = width * 4
+    };
+
+    CaptureDumpReader() = default;
+    ~CaptureDumpReader();
+
+    CaptureDumpReader(const CaptureDumpReader &) = delete;
+    CaptureDumpReader &operator=(const CaptureDumpReader &) = delete;
+
+    bool Open(const std::string &path);
+    const CaptureDumpFileHeader *file_header() const { return file_header_; }
+    const std::vector<Frame> &frames() const { return frames_; }
+
+private:
+    int fd_{-1};
+    const uint8_t *map_{nullptr};
+    size_t map_size_{0};
+    const CaptureDumpFileHeader *file_header_{nullptr};
+    std::vector<Frame> frames_;
+};
@@ -0,0 +1,273 @@
+#include "codec_benchmark.h"
+#include "pushclient.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "api/environment/environment_factory.h"
+#include "api/video/i420_buffer.h"
+#include "api/video/video_bitrate_allocation.h"
+#include "api/video/video_frame.h"
+#include "api/video_codecs/video_codec.h"
+#include "api/video_codecs/video_encoder.h"
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/logging.h"
+
+namespace
+{
+    class CountingCallback : public webrtc::EncodedImageCallback
+    {
+    public:
+        Result OnEncodedImage(const webrtc::EncodedImage &, const webrtc::CodecSpecificInfo *) override
+        {
+            ++frames;
+            return Result(Result::OK);
+        }
+        int frames{0};
+    };
+
+    // 基准在后台和预热连接、采集转换、首批观看端的编码器同时运行，进程级 CPU 会把它们算进来，
+    // 所以只统计本线程（编码器以单核初始化，编码都在调用线程上完成）
+    int64_t ThreadCpuMicros()
+    {
+        rusage ru{};
+        getrusage(RUSAGE_THREAD, &ru);
+        return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1'000'000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+    }
+
+    // 合成一页“文档”：白底黑字的文字行，scroll 为滚动的像素行数，typed 为光标行已输入的字符数
+    void DrawTextPage(webrtc::I420Buffer *buf, int scroll, int typed)
+    {
+        const int w = buf->width();
+        const int h = buf->height();
+        constexpr int kLineHeight = 20;
+        constexpr int kGlyphWidth = 9;
+        constexpr int kGlyphHeight = 12;
+
+        for (int y = 0; y < h; ++y)
+        {
+            uint8_t *row = buf->MutableDataY() + y * buf->StrideY();
+            memset(row, 235, w);
+            const int doc_y = y + scroll;
+            const int line = doc_y / kLineHeight;
+            const int in_line = doc_y % kLineHeight;
+            if (in_line < 4 || in_line >= 4 + kGlyphHeight)
+                continue;
+            const bool cursor_line = (line == (scroll / kLineHeight) + h / kLineHeight / 2);
+            for (int col = 0; col * kGlyphWidth < w - kGlyphWidth; ++col)
+            {
+                // 伪随机字形：按 (行, 列) 哈希决定是否有字、字形的笔画位置
+                const uint32_t hsh = static_cast<uint32_t>(line * 73856093) ^ static_cast<uint32_t>(col * 19349663);
+                const bool has_glyph = cursor_line ? (col < typed) : ((hsh % 7) != 0 && (line % 9) != 0);
+                if (!has_glyph)
+                    continue;
+                const int stroke = 1 + (hsh >> 3) % 6;
+                uint8_t *p = row + col * kGlyphWidth;
+                p[stroke] = 16;
+                p[stroke + 1] = 16;
+                if (((in_line + static_cast<int>(hsh >> 5)) & 3) == 0)
+                    memset(p + 1, 16, kGlyphWidth - 2);
+            }
+        }
+        const int cw = buf->ChromaWidth();
+        const int ch = buf->ChromaHeight();
+        for (int y = 0; y < ch; ++y)
+        {
+            memset(buf->MutableDataU() + y * buf->StrideU(), 128, cw);
+            memset(buf->MutableDataV() + y * buf->StrideV(), 128, cw);
+        }
+    }
+
+    webrtc::VideoCodec MakeCodecSettings(const webrtc::SdpVideoFormat &format, const CodecBenchmarkOptions &options)
+    {
+        webrtc::VideoCodec codec;
+        codec.codecType = webrtc::PayloadStringToCodecType(format.name);
+        codec.width = static_cast<uint16_t>(options.width);
+        codec.height = static_cast<uint16_t>(options.height);
+        codec.maxFramerate = options.target_fps;
+        codec.startBitrate = options.bitrate_bps / 1000;
+        codec.maxBitrate = options.bitrate_bps / 1000;
+        codec.minBitrate = 30;
+        codec.qpMax = 56;
+        codec.mode = webrtc::VideoCodecMode::kScreensharing;
+        codec.SetScalabilityMode(webrtc::ScalabilityMode::kL1T1);
+        codec.numberOfSimulcastStreams = 1;
+
+        webrtc::SimulcastStream &stream = codec.simulcastStream[0];
+        stream.width = options.width;
+        stream.height = options.height;
+        stream.maxFramerate = options.target_fps;
+        stream.maxBitrate = codec.maxBitrate;
+        stream.targetBitrate = codec.maxBitrate;
+        stream.minBitrate = codec.minBitrate;
+        stream.qpMax = codec.qpMax;
+        stream.active = true;
+        codec.spatialLayers[0] = stream;
+
+        switch (codec.codecType)
+        {
+        case webrtc::kVideoCodecVP8:
+            *codec.VP8() = webrtc::VideoEncoder::GetDefaultVp8Settings();
+            break;
+        case webrtc::kVideoCodecVP9:
+            *codec.VP9() = webrtc::VideoEncoder::GetDefaultVp9Settings();
+            break;
+        case webrtc::kVideoCodecH264:
+            *codec.H264() = webrtc::VideoEncoder::GetDefaultH264Settings();
+            break;
+        default:
+            break;
+        }
+        return codec;
+    }
+
+    CodecBenchmarkResult BenchmarkOne(const webrtc::Environment &env, webrtc::VideoEncoderFactory &factory,
+                                      const webrtc::SdpVideoFormat &format, const CodecBenchmarkOptions &options)
+    {
+        CodecBenchmarkResult result;
+        result.codec = format.name;
+
+        std::unique_ptr<webrtc::VideoEncoder> encoder = factory.Create(env, format);
+        if (!encoder)
+            return result;
+
+        webrtc::VideoCodec codec = MakeCodecSettings(format, options);
+        // 单核：编码器不开内部线程，CPU 耗时全部落在本线程上，各 codec 之间可比
+        webrtc::VideoEncoder::Settings settings(webrtc::VideoEncoder::Capabilities(false), 1, 1200);
+        if (encoder->InitEncode(&codec, settings) != WEBRTC_VIDEO_CODEC_OK)
+        {
+            RTC_LOG(LS_WARNING) << "[codec-bench] InitEncode failed for " << format.name;
+            return result;
+        }
+
+        CountingCallback callback;
+        encoder->RegisterEncodeCompleteCallback(&callback);
+        webrtc::VideoBitrateAllocation allocation;
+        allocation.SetBitrate(0, 0, options.bitrate_bps);
+        encoder->SetRates(webrtc::VideoEncoder::RateControlParameters(allocation, options.target_fps));
+
+        std::vector<webrtc::VideoFrameType> key_frame{webrtc::VideoFrameType::kVideoFrameKey};
+        std::vector<webrtc::VideoFrameType> delta_frame{webrtc::VideoFrameType::kVideoFrameDelta};
+
+        int64_t encode_us = 0;
+        int64_t cpu_us = 0;
+        int scroll = 0;
+        for (int i = 0; i < options.frames; ++i)
+        {
+            // 每帧多打一个字，每 15 帧滚动一行，模拟阅读/编辑文档
+            if (i > 0 && i % 15 == 0)
+                scroll += 20;
+            auto buffer = webrtc::I420Buffer::Create(options.width, options.height);
+            DrawTextPage(buffer.get(), scroll, i % 120);
+            webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+                                           .set_video_frame_buffer(buffer)
+                                           .set_rtp_timestamp(static_cast<uint32_t>(i * 90000 / options.target_fps))
+                                           .set_timestamp_us(int64_t{i} * 1'000'000 / options.target_fps)
+                                           .build();
+
+            const int64_t cpu_start = ThreadCpuMicros();
+            const auto wall_start = std::chrono::steady_clock::now();
+            encoder->Encode(frame, i == 0 ? &key_frame : &delta_frame);
+            encode_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wall_start).count();
+            cpu_us += ThreadCpuMicros() - cpu_start;
+        }
+        encoder->Release();
+
+        result.ok = true;
+        result.encoded_frames = callback.frames;
+        result.avg_encode_ms = encode_us / 1000.0 / std::max(1, options.frames);
+        result.cpu_ms_per_frame = cpu_us / 1000.0 / std::max(1, options.frames);
+        result.achievable_fps = result.avg_encode_ms > 0 ? 1000.0 / result.avg_encode_ms : 0;
+        result.meets_target = result.achievable_fps >= options.target_fps;
+        return result;
+    }
+
+    std::mutex g_bench_mutex;
+    std::vector<std::string> g_cached_preferences;
+    bool g_bench_started = false;
+
+    // 进程退出时等待后台基准结束，避免编码器在静态析构期间仍在运行
+    struct BenchThreadHolder
+    {
+        std::thread thread;
+        ~BenchThreadHolder()
+        {
+            if (thread.joinable())
+                thread.join();
+        }
+    };
+    BenchThreadHolder g_bench_thread;
+} // namespace
+
+std::vector<CodecBenchmarkResult> CodecBenchmark::Run(webrtc::VideoEncoderFactory &factory,
+                                                      const CodecBenchmarkOptions &options)
+{
+    const webrtc::Environment env = webrtc::CreateEnvironment();
+    std::vector<CodecBenchmarkResult> results;
+    std::set<std::string> seen;
+    for (const auto &format : factory.GetSupportedFormats())
+    {
+        // 同一 codec 的多个 profile 只测第一个
+        if (!seen.insert(format.name).second)
+            continue;
+        CodecBenchmarkResult r = BenchmarkOne(env, factory, format, options);
+        RTC_LOG(LS_INFO) << "[codec-bench] " << r.codec << " ok=" << r.ok
+                         << " encoded=" << r.encoded_frames << "/" << options.frames
+                         << " encode_ms=" << r.avg_encode_ms
+                         << " cpu_ms=" << r.cpu_ms_per_frame
+                         << " fps=" << r.achievable_fps;
+        results.push_back(r);
+    }
+    return results;
+}
+
+std::vector<std::string> CodecBenchmark::RankCodecs(const std::vector<CodecBenchmarkResult> &results)
+{
+    std::vector<CodecBenchmarkResult> ranked;
+    for (const auto &r : results)
+    {
+        if (r.ok && r.encoded_frames > 0)
+            ranked.push_back(r);
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const CodecBenchmarkResult &a, const CodecBenchmarkResult &b)
+              {
+                  if (a.meets_target != b.meets_target)
+                      return a.meets_target;
+                  if (a.meets_target)
+                      return a.cpu_ms_per_frame < b.cpu_ms_per_frame;
+                  return a.achievable_fps > b.achievable_fps; });
+
+    std::vector<std::string> names;
+    for (const auto &r : ranked)
+        names.push_back(r.codec);
+    return names;
+}
+
+void CodecBenchmark::StartInBackground(const CodecBenchmarkOptions &options)
+{
+    std::lock_guard<std::mutex> lock(g_bench_mutex);
+    if (g_bench_started)
+        return;
+    g_bench_started = true;
+
+    g_bench_thread.thread = std::thread([options]()
+                                        {
+        auto factory = CreateDesktopVideoEncoderFactory();
+        auto ranked = RankCodecs(Run(*factory, options));
+        if (!ranked.empty())
+            RTC_LOG(LS_INFO) << "[codec-bench] preferred codec: " << ranked.front();
+        std::lock_guard<std::mutex> lock(g_bench_mutex);
+        g_cached_preferences = std::move(ranked); });
+}
+
+std::vector<std::string> CodecBenchmark::CachedPreferences()
+{
+    std::lock_guard<std::mutex> lock(g_bench_mutex);
+    return g_cached_preferences;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "api/video_codecs/video_encoder_factory.h"
+
+struct CodecBenchmarkOptions
+{
+    int width{1920};
+    int height{1080};
+    int target_fps{30};
+    int frames{60};
+    int bitrate_bps{2'000'000};
+};
+
+struct CodecBenchmarkResult
+{
+    std::string codec;             // codec 名称，如 "VP8"
+    bool ok{false};                // 编码器创建/初始化是否成功
+    int encoded_frames{0};
+    double avg_encode_ms{0};       // 单帧 Encode 墙钟耗时
+    double cpu_ms_per_frame{0};    // 单帧编码 CPU 耗时（单线程编码，只计基准线程本身）
+    double achievable_fps{0};      // 1000 / avg_encode_ms
+    bool meets_target{false};
+};
+
+// 启动时的编码器微基准：用合成的屏幕内容（文字行 + 打字 + 滚动）逐个测试可用编码器，
+// 选出满足目标帧率且 CPU 最低的 codec，作为 SetCodecPreferences 的默认顺序。
+class CodecBenchmark
+{
+public:
+    static std::vector<CodecBenchmarkResult> Run(webrtc::VideoEncoderFactory &factory,
+                                                 const CodecBenchmarkOptions &options);
+
+    // 满足目标帧率的按 CPU 升序排在前面，其余按可达帧率降序
+    static std::vector<std::string> RankCodecs(const std::vector<CodecBenchmarkResult> &results);
+
+    // 在后台线程跑一次并缓存排序结果，重复调用无效
+    static void StartInBackground(const CodecBenchmarkOptions &options = {});
+    // 基准未完成时返回空
+    static std::vector<std::string> CachedPreferences();
+};
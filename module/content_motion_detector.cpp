@@ -0,0 +1,46 @@
+#include "content_motion_detector.h"
+
+#include <algorithm>
+
+#include "modules/desktop_capture/desktop_region.h"
+
+ContentMotionDetector::ContentMotionDetector()
+    : ContentMotionDetector(Config{})
+{
+}
+
+ContentMotionDetector::ContentMotionDetector(const Config &config, ContentMode initial)
+    : config_(config), mode_(initial)
+{
+}
+
+std::optional<ContentMode> ContentMotionDetector::OnFrame(const webrtc::DesktopFrame &frame, int64_t now_ms)
+{
+    const int64_t frame_area = static_cast<int64_t>(frame.size().width()) * frame.size().height();
+    if (frame_area <= 0)
+        return std::nullopt;
+
+    // updated_region 中的矩形互不重叠，直接累加面积
+    int64_t changed_area = 0;
+    for (webrtc::DesktopRegion::Iterator it(frame.updated_region()); !it.IsAtEnd(); it.Advance())
+        changed_area += static_cast<int64_t>(it.rect().width()) * it.rect().height();
+    const double ratio = std::min(1.0, static_cast<double>(changed_area) / frame_area);
+
+    score_ += config_.smoothing * (ratio - score_);
+    if (last_switch_ms_ == 0)
+        last_switch_ms_ = now_ms;
+    if (now_ms - last_switch_ms_ < config_.min_hold_ms)
+        return std::nullopt;
+
+    ContentMode next = mode_;
+    if (mode_ != ContentMode::kFluid && score_ > config_.enter_fluid_ratio)
+        next = ContentMode::kFluid;
+    else if (mode_ == ContentMode::kFluid && score_ < config_.exit_fluid_ratio)
+        next = ContentMode::kText;
+    if (next == mode_)
+        return std::nullopt;
+
+    mode_ = next;
+    last_switch_ms_ = now_ms;
+    return next;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+
+#include "modules/desktop_capture/desktop_frame.h"
+#include "video_send_config.h"
+
+// 根据 DesktopFrame::updated_region() 的变化面积判断当前屏幕内容：
+// 静态/文字（阅读文档）还是高运动（播放视频、拖动窗口），带滞回和最短保持时间，避免来回抖动。
+// 本类不加锁：CapturerTrackSource 在转换线程调用 OnFrame，创建（AddContentModeCallback）在其它线程，
+// 两处都持 content_mutex_。
+class ContentMotionDetector
+{
+public:
+    struct Config
+    {
+        double enter_fluid_ratio{0.10}; // 平滑后的每帧变化面积比例超过该值进入 fluid
+        double exit_fluid_ratio{0.03};  // 低于该值回到 text
+        double smoothing{0.2};          // 指数平滑系数，越大越灵敏
+        int min_hold_ms{2000};          // 两次切换之间的最短间隔
+    };
+
+    ContentMotionDetector();
+    explicit ContentMotionDetector(const Config &config, ContentMode initial = ContentMode::kText);
+
+    // 每帧调用一次；分类发生变化时返回新的模式
+    std::optional<ContentMode> OnFrame(const webrtc::DesktopFrame &frame, int64_t now_ms);
+
+    ContentMode mode() const { return mode_; }
+    double motion_score() const { return score_; }
+
+private:
+    Config config_;
+    ContentMode mode_;
+    double score_{0};
+    int64_t last_switch_ms_{0};
+};
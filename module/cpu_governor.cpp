@@ -0,0 +1,181 @@
+#include "cpu_governor.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "pushclient.h"
+#include "async_log_sink.h"
+#include "rtc_base/logging.h"
+
+namespace
+{
+    int64_t ProcessCpuMicros()
+    {
+        rusage ru{};
+        getrusage(RUSAGE_SELF, &ru);
+        return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1'000'000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+    }
+} // namespace
+
+CpuBudgetGovernor &CpuBudgetGovernor::Instance()
+{
+    static CpuBudgetGovernor governor;
+    return governor;
+}
+
+CpuBudgetGovernor::~CpuBudgetGovernor()
+{
+    Stop();
+}
+
+void CpuBudgetGovernor::Start(double budget_cores, int interval_ms)
+{
+    if (budget_cores <= 0 || running_.exchange(true))
+        return;
+    budget_cores_.store(budget_cores);
+    last_process_cpu_us_ = ProcessCpuMicros();
+    thread_ = std::thread(&CpuBudgetGovernor::Loop, this, std::max(200, interval_ms));
+    RTC_LOG(LS_INFO) << "[CPU-GOV] started, budget=" << budget_cores << " cores";
+}
+
+void CpuBudgetGovernor::Stop()
+{
+    running_.store(false);
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void CpuBudgetGovernor::Register(WebRTCPushClient *client)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    peers_.push_back({client, next_join_order_++, client->CaptureCpuMicros(), 0});
+}
+
+void CpuBudgetGovernor::Unregister(WebRTCPushClient *client)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    peers_.erase(std::remove_if(peers_.begin(), peers_.end(),
+                                [client](const PeerState &p)
+                                { return p.client == client; }),
+                 peers_.end());
+    // Evaluate 可能正在锁外调整该观看端，等它返回后才允许析构
+    calling_done_.wait(lock, [&]
+                       { return calling_ != client; });
+}
+
+bool CpuBudgetGovernor::WouldExceedBudget()
+{
+    if (!running_.load())
+        return false;
+    const double budget = budget_cores_.load();
+    const double used = last_process_cores_.load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double per_peer = peers_.empty() ? 0.0 : used / peers_.size();
+    return used + per_peer > budget;
+}
+
+void CpuBudgetGovernor::Loop(int interval_ms)
+{
+    auto last = std::chrono::steady_clock::now();
+    while (running_.load())
+    {
+        // 分段睡眠，Stop 时能尽快退出
+        for (int slept = 0; slept < interval_ms && running_.load(); slept += 100)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!running_.load())
+            break;
+        const auto now = std::chrono::steady_clock::now();
+        Evaluate(std::chrono::duration<double>(now - last).count());
+        last = now;
+    }
+}
+
+void CpuBudgetGovernor::Evaluate(double interval_s)
+{
+    if (interval_s <= 0)
+        return;
+    const int64_t cpu_us = ProcessCpuMicros();
+    const double process_cores = (cpu_us - last_process_cpu_us_) / 1e6 / interval_s;
+    last_process_cpu_us_ = cpu_us;
+    last_process_cores_.store(process_cores);
+
+    WebRTCPushClient *target = nullptr;
+    int new_level = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (peers_.empty())
+            return;
+
+        // 每个观看端的开销 = 采集线程 CPU + 编码耗时（encode fps * 每帧编码耗时），仅用于日志
+        for (auto &p : peers_)
+        {
+            const int64_t capture_us = p.client->CaptureCpuMicros();
+            const VideoSendMetrics m = p.client->GetVideoSendMetrics();
+            p.cost_cores = (capture_us - p.last_capture_cpu_us) / 1e6 / interval_s + m.encode_fps * m.avg_encode_ms / 1000.0;
+            p.last_capture_cpu_us = capture_us;
+        }
+
+        const double budget = budget_cores_.load();
+        // 重要性：priority 越小越不重要，同优先级时后加入的先降级
+        auto less_important = [](const PeerState &a, const PeerState &b)
+        {
+            const int pa = a.client->GetPriority();
+            const int pb = b.client->GetPriority();
+            return pa != pb ? pa < pb : a.join_order > b.join_order;
+        };
+        // 共用编码器的观看端不能单独降帧率/分辨率，不参与降级/恢复
+        std::vector<PeerState *> order;
+        for (auto &p : peers_)
+            if (!p.client->SharesEncoder())
+                order.push_back(&p);
+        std::sort(order.begin(), order.end(), [&](PeerState *a, PeerState *b)
+                  { return less_important(*a, *b); });
+
+        if (process_cores > budget)
+        {
+            for (PeerState *p : order)
+            {
+                const int level = p->client->GetCpuDegradationLevel();
+                if (level >= kMaxDegradationLevel)
+                    continue;
+                RTC_LOG(LS_INFO) << "[CPU-GOV] process=" << process_cores << " > budget=" << budget
+                                 << ", degrade " << p->client->getId() << " (cost=" << p->cost_cores
+                                 << " cores) to level " << level + 1;
+                target = p->client;
+                new_level = level + 1;
+                break;
+            }
+            if (!target)
+                RTC_LOG_EVERY_SEC(LS_WARNING, 1) << "[CPU-GOV] over budget but no adjustable peer left ("
+                                                 << peers_.size() - order.size() << " on shared encoders)";
+        }
+        else if (process_cores < budget * 0.8)
+        {
+            // 有富余时从最重要的开始恢复，一次只恢复一级
+            for (auto it = order.rbegin(); it != order.rend(); ++it)
+            {
+                const int level = (*it)->client->GetCpuDegradationLevel();
+                if (level == 0)
+                    continue;
+                RTC_LOG(LS_INFO) << "[CPU-GOV] process=" << process_cores << " < budget=" << budget
+                                 << ", restore " << (*it)->client->getId() << " to level " << level - 1;
+                target = (*it)->client;
+                new_level = level - 1;
+                break;
+            }
+        }
+        if (!target)
+            return;
+        calling_ = target;
+    }
+
+    // SetCpuDegradationLevel 会 BlockingCall 到信令线程，不能持锁调用，否则 Register/Unregister/WouldExceedBudget 都会被卡住
+    target->SetCpuDegradationLevel(new_level);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        calling_ = nullptr;
+    }
+    calling_done_.notify_all();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WebRTCPushClient;
+
+// 进程级 CPU 预算：周期性统计整个进程的 CPU（getrusage）以及每个观看端的采集+编码开销，
+// 超出预算时先降低优先级最低的观看端的帧率/分辨率，预算有富余时按优先级从高到低逐级恢复。
+// 是否降级/恢复只看进程总 CPU；每个观看端的开销仅用于日志，共享采集/编码时会重复计入。
+// 共用编码器（SharesEncoder）的观看端不参与降级/恢复。
+class CpuBudgetGovernor
+{
+public:
+    static constexpr int kMaxDegradationLevel = 6;
+
+    static CpuBudgetGovernor &Instance();
+
+    // budget_cores 为允许使用的核数（例如 4 核机器上 3.0），<= 0 表示不启用
+    void Start(double budget_cores, int interval_ms = 2000);
+    void Stop();
+
+    void Register(WebRTCPushClient *client);
+    // 推流客户端析构前必须调用，返回后 governor 不会再访问该对象
+    void Unregister(WebRTCPushClient *client);
+
+    double LastProcessCores() const { return last_process_cores_.load(); }
+    // 按当前观看端的平均开销估算，再加一个观看端是否会超出预算（未启用时返回 false）
+    bool WouldExceedBudget();
+
+private:
+    CpuBudgetGovernor() = default;
+    ~CpuBudgetGovernor();
+
+    struct PeerState
+    {
+        WebRTCPushClient *client;
+        uint64_t join_order;
+        int64_t last_capture_cpu_us;
+        double cost_cores;
+    };
+
+    void Loop(int interval_ms);
+    void Evaluate(double interval_s);
+
+    std::mutex mutex_;
+    std::vector<PeerState> peers_;
+    // 正在锁外调用 SetCpuDegradationLevel 的观看端，Unregister 需等待其返回
+    WebRTCPushClient *calling_{nullptr};
+    std::condition_variable calling_done_;
+    uint64_t next_join_order_{0};
+    int64_t last_process_cpu_us_{0};
+
+    std::atomic<double> budget_cores_{0};
+    std::atomic<double> last_process_cores_{0};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
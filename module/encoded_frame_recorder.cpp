@@ -0,0 +1,264 @@
+#include "encoded_frame_recorder.h"
+
+#include <cstring>
+
+#include "rtc_base/logging.h"
+
+namespace
+{
+    // 写线程攒够这么多再 fwrite
+    constexpr size_t kWriteChunkBytes = 1 << 20;
+    // 写盘跟不上时队列的上限，超出后丢帧并等下一个关键帧
+    constexpr size_t kMaxQueuedBytes = 32 << 20;
+    constexpr size_t kIvfHeaderSize = 32;
+    constexpr size_t kIvfFrameHeaderSize = 12;
+
+    void PutLe16(uint8_t *p, uint16_t v)
+    {
+        p[0] = v & 0xff;
+        p[1] = v >> 8;
+    }
+
+    void PutLe32(uint8_t *p, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (v >> (8 * i)) & 0xff;
+    }
+
+    void PutLe64(uint8_t *p, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            p[i] = (v >> (8 * i)) & 0xff;
+    }
+
+    // "video/VP8" -> "VP80"，IVF 不支持的 codec 返回 false
+    bool FourccForMime(const std::string &mime, char out[4])
+    {
+        const char *fourcc = nullptr;
+        if (mime == "video/VP8")
+            fourcc = "VP80";
+        else if (mime == "video/VP9")
+            fourcc = "VP90";
+        else if (mime == "video/AV1")
+            fourcc = "AV01";
+        else if (mime == "video/H264")
+            fourcc = "H264";
+        if (!fourcc)
+            return false;
+        std::memcpy(out, fourcc, 4);
+        return true;
+    }
+} // namespace
+
+EncodedFrameRecorder::EncodedFrameRecorder(std::string rid)
+    : rid_(std::move(rid))
+{
+}
+
+EncodedFrameRecorder::~EncodedFrameRecorder()
+{
+    Stop();
+}
+
+bool EncodedFrameRecorder::Start(const std::string &path)
+{
+    Stop();
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        RTC_LOG(LS_ERROR) << "[RECORD] open " << path << " failed";
+        return false;
+    }
+    // 自己攒大块再写，不需要 stdio 缓冲
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_ = file;
+    stopping_ = false;
+    ssrc_ = 0;
+    need_keyframe_ = true;
+    pts_ = 0;
+    width_ = height_ = 0;
+    frame_count_ = 0;
+    std::memset(fourcc_, 0, sizeof(fourcc_));
+    // 先占位，Stop 时回填分辨率和帧数
+    WriteHeader(0);
+    writer_ = std::thread(&EncodedFrameRecorder::WriterLoop, this);
+    recording_.store(true);
+    RTC_LOG(LS_INFO) << "[RECORD] recording to " << path;
+    return true;
+}
+
+void EncodedFrameRecorder::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_)
+            return;
+        recording_.store(false);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (writer_.joinable())
+        writer_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fseek(file_, 0, SEEK_SET);
+    WriteHeader(frame_count_);
+    std::fclose(file_);
+    file_ = nullptr;
+    RTC_LOG(LS_INFO) << "[RECORD] stopped, " << frame_count_ << " frames " << width_ << "x" << height_
+                     << ", dropped " << frames_dropped_.load();
+}
+
+void EncodedFrameRecorder::WriteHeader(uint32_t frame_count)
+{
+    uint8_t header[kIvfHeaderSize] = {'D', 'K', 'I', 'F'};
+    PutLe16(header + 4, 0);
+    PutLe16(header + 6, kIvfHeaderSize);
+    std::memcpy(header + 8, fourcc_, 4);
+    PutLe16(header + 12, width_);
+    PutLe16(header + 14, height_);
+    // 时间基为 RTP 的 90kHz
+    PutLe32(header + 16, 90000);
+    PutLe32(header + 20, 1);
+    PutLe32(header + 24, frame_count);
+    std::fwrite(header, 1, sizeof(header), file_);
+}
+
+void EncodedFrameRecorder::Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame)
+{
+    // libwebrtc 不带 RTTI，按 mime 类型判断是否为视频帧
+    if (recording_.load() && frame->GetDirection() == webrtc::TransformableFrameInterface::Direction::kSender &&
+        frame->GetMimeType().rfind("video/", 0) == 0)
+    {
+        Record(static_cast<const webrtc::TransformableVideoFrameInterface &>(*frame));
+    }
+
+    webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        auto it = sink_callbacks_.find(frame->GetSsrc());
+        callback = it != sink_callbacks_.end() ? it->second : callback_;
+    }
+    if (callback)
+        callback->OnTransformedFrame(std::move(frame));
+}
+
+void EncodedFrameRecorder::Record(const webrtc::TransformableVideoFrameInterface &frame)
+{
+    if (!rid_.empty() && frame.Rid().value_or("") != rid_)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_ || stopping_)
+        return;
+    if (ssrc_ == 0)
+    {
+        // 从第一个关键帧开始，顺便确定 codec 和分辨率
+        if (!frame.IsKeyFrame() || !FourccForMime(frame.GetMimeType(), fourcc_))
+            return;
+        ssrc_ = frame.GetSsrc();
+        width_ = frame.Metadata().GetWidth();
+        height_ = frame.Metadata().GetHeight();
+        last_rtp_ts_ = frame.GetTimestamp();
+    }
+    if (frame.GetSsrc() != ssrc_)
+        return;
+    if (need_keyframe_ && !frame.IsKeyFrame())
+        return;
+
+    auto data = frame.GetData();
+    if (queued_bytes_ + data.size() > kMaxQueuedBytes)
+    {
+        frames_dropped_++;
+        need_keyframe_ = true;
+        return;
+    }
+    need_keyframe_ = false;
+
+    // RTP 时间戳 32 位回绕，按差值累加
+    pts_ += static_cast<uint32_t>(frame.GetTimestamp() - last_rtp_ts_);
+    last_rtp_ts_ = frame.GetTimestamp();
+
+    PendingFrame pending;
+    pending.data.assign(data.begin(), data.end());
+    pending.pts = pts_;
+    queued_bytes_ += pending.data.size();
+    queue_.push_back(std::move(pending));
+    cv_.notify_one();
+}
+
+void EncodedFrameRecorder::WriterLoop()
+{
+    std::vector<uint8_t> chunk;
+    chunk.reserve(kWriteChunkBytes + (1 << 16));
+    size_t chunk_payload = 0; // chunk 里帧数据的字节数，写盘后才从 queued_bytes_ 扣除
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 调用时不持锁；磁盘慢时已取出未写盘的帧仍计入上限，排队总量不会超过 kMaxQueuedBytes
+    auto flush = [&](FILE *file)
+    {
+        std::fwrite(chunk.data(), 1, chunk.size(), file);
+        chunk.clear();
+        std::lock_guard<std::mutex> relock(mutex_);
+        queued_bytes_ -= chunk_payload;
+        chunk_payload = 0;
+    };
+    while (true)
+    {
+        // 队列空时最多等 200ms，把攒着的数据写掉，避免长时间不落盘
+        cv_.wait_for(lock, std::chrono::milliseconds(200), [this]()
+                     { return stopping_ || !queue_.empty(); });
+        std::deque<PendingFrame> frames;
+        frames.swap(queue_);
+        const bool stopping = stopping_;
+        FILE *file = file_;
+        lock.unlock();
+
+        for (const auto &f : frames)
+        {
+            uint8_t header[kIvfFrameHeaderSize];
+            PutLe32(header, static_cast<uint32_t>(f.data.size()));
+            PutLe64(header + 4, f.pts);
+            chunk.insert(chunk.end(), header, header + sizeof(header));
+            chunk.insert(chunk.end(), f.data.begin(), f.data.end());
+            chunk_payload += f.data.size();
+            if (chunk.size() >= kWriteChunkBytes)
+                flush(file);
+        }
+        if (!chunk.empty() && (frames.empty() || stopping))
+            flush(file);
+        frames_written_ += frames.size();
+
+        lock.lock();
+        frame_count_ += static_cast<uint32_t>(frames.size());
+        if (stopping && queue_.empty())
+            break;
+    }
+}
+
+void EncodedFrameRecorder::RegisterTransformedFrameCallback(
+    webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback)
+{
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = std::move(callback);
+}
+
+void EncodedFrameRecorder::RegisterTransformedFrameSinkCallback(
+    webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback, uint32_t ssrc)
+{
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    sink_callbacks_[ssrc] = std::move(callback);
+}
+
+void EncodedFrameRecorder::UnregisterTransformedFrameCallback()
+{
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = nullptr;
+}
+
+void EncodedFrameRecorder::UnregisterTransformedFrameSinkCallback(uint32_t ssrc)
+{
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    sink_callbacks_.erase(ssrc);
+}
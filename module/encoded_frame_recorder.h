@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api/frame_transformer_interface.h"
+#include "api/scoped_refptr.h"
+
+// 录制编码后的帧：作为 RtpSender 的 FrameTransformer 挂在编码器和打包之间，
+// 帧原样透传，同时把数据拷贝到后台线程写成 IVF（VP8/VP9/AV1/H264），不需要额外编码。
+// simulcast 时只录一路：指定 rid 时录该层，否则录第一个出现关键帧的流。
+class EncodedFrameRecorder : public webrtc::FrameTransformerInterface
+{
+public:
+    explicit EncodedFrameRecorder(std::string rid = "");
+    ~EncodedFrameRecorder() override;
+
+    // 开始写 path，已在录制时先结束上一个文件
+    bool Start(const std::string &path);
+    // 写完队列中的帧并补全 IVF 头（分辨率、帧数）
+    void Stop();
+    bool recording() const { return recording_.load(); }
+
+    uint64_t frames_written() const { return frames_written_.load(); }
+    uint64_t frames_dropped() const { return frames_dropped_.load(); }
+
+    // --- webrtc::FrameTransformerInterface ---
+    void Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame) override;
+    void RegisterTransformedFrameCallback(webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback) override;
+    void RegisterTransformedFrameSinkCallback(webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback,
+                                              uint32_t ssrc) override;
+    void UnregisterTransformedFrameCallback() override;
+    void UnregisterTransformedFrameSinkCallback(uint32_t ssrc) override;
+
+private:
+    struct PendingFrame
+    {
+        std::vector<uint8_t> data;
+        uint64_t pts;
+    };
+
+    void Record(const webrtc::TransformableVideoFrameInterface &frame);
+    void WriterLoop();
+    void WriteHeader(uint32_t frame_count);
+
+    const std::string rid_;
+
+    // 透传回调
+    std::mutex callback_mutex_;
+    webrtc::scoped_refptr<webrtc::TransformedFrameCallback> callback_;
+    std::map<uint32_t, webrtc::scoped_refptr<webrtc::TransformedFrameCallback>> sink_callbacks_;
+
+    // 录制状态与写队列
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<PendingFrame> queue_;
+    size_t queued_bytes_{0};
+    FILE *file_{nullptr};
+    std::thread writer_;
+    bool stopping_{false};
+    uint32_t ssrc_{0};          // 正在录制的流，0 表示还没选定
+    bool need_keyframe_{true};  // 开始或丢帧后等关键帧，保证文件可解码
+    uint32_t last_rtp_ts_{0};
+    uint64_t pts_{0};
+    char fourcc_[4]{};
+    uint16_t width_{0};
+    uint16_t height_{0};
+    uint32_t frame_count_{0};
+
+    std::atomic<bool> recording_{false};
+    std::atomic<uint64_t> frames_written_{0};
+    std::atomic<uint64_t> frames_dropped_{0};
+};
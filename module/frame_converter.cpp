@@ -0,0 +1,363 @@
+#include "frame_converter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+#include "libyuv/cpu_id.h"
+#include "media/base/video_common.h"
+#include "rtc_base/logging.h"
+
+namespace
+{
+    struct IsaLevel
+    {
+        const char *name;
+        int required; // 本机要有这个特性才算可用
+        int mask;     // 交给 libyuv::MaskCpuFlags，包含 libyuv 的“已初始化”位 0x1
+    };
+
+    constexpr int kCpuInitialized = 0x1;
+
+    // 每一级包含前面所有级别的特性
+    constexpr IsaLevel kX86Levels[] = {
+        {"c", 0, kCpuInitialized},
+        {"sse2", libyuv::kCpuHasSSE2, kCpuInitialized | libyuv::kCpuHasX86 | libyuv::kCpuHasSSE2},
+        {"ssse3", libyuv::kCpuHasSSSE3,
+         kCpuInitialized | libyuv::kCpuHasX86 | libyuv::kCpuHasSSE2 | libyuv::kCpuHasSSSE3 | libyuv::kCpuHasSSE41 |
+             libyuv::kCpuHasSSE42},
+        {"avx2", libyuv::kCpuHasAVX2,
+         kCpuInitialized | libyuv::kCpuHasX86 | libyuv::kCpuHasSSE2 | libyuv::kCpuHasSSSE3 | libyuv::kCpuHasSSE41 |
+             libyuv::kCpuHasSSE42 | libyuv::kCpuHasAVX | libyuv::kCpuHasAVX2 | libyuv::kCpuHasERMS |
+             libyuv::kCpuHasFSMR | libyuv::kCpuHasFMA3 | libyuv::kCpuHasF16C},
+        {"avx512", libyuv::kCpuHasAVX512BW, -1},
+    };
+    constexpr IsaLevel kArmLevels[] = {
+        {"c", 0, kCpuInitialized},
+        {"neon", libyuv::kCpuHasNEON,
+         kCpuInitialized | libyuv::kCpuHasARM | libyuv::kCpuHasNEON | libyuv::kCpuHasNeonDotProd |
+             libyuv::kCpuHasNeonI8MM},
+        {"sve", libyuv::kCpuHasSVE, -1},
+    };
+    // 其它架构只区分 C 和 libyuv 检测到的全部特性
+    constexpr IsaLevel kOtherLevels[] = {
+        {"c", 0, kCpuInitialized},
+        {"native", 0, -1},
+    };
+
+    std::mutex g_isa_mutex;
+    int g_detected_flags = 0;
+    std::string g_isa;
+    int g_isa_mask = -1;
+
+    std::vector<IsaLevel> AvailableLevels(int flags)
+    {
+        std::vector<IsaLevel> levels;
+        auto add = [&](const auto &table)
+        {
+            for (const IsaLevel &level : table)
+                if (level.required == 0 || (flags & level.required))
+                    levels.push_back(level);
+        };
+        if (flags & libyuv::kCpuHasX86)
+            add(kX86Levels);
+        else if (flags & libyuv::kCpuHasARM)
+            add(kArmLevels);
+        else
+            add(kOtherLevels);
+        return levels;
+    }
+
+    int DetectedFlags()
+    {
+        std::lock_guard<std::mutex> lock(g_isa_mutex);
+        if (g_detected_flags == 0)
+        {
+            // 先清掉可能的掩码，拿到本机完整的特性
+            libyuv::MaskCpuFlags(-1);
+            g_detected_flags = libyuv::InitCpuFlags();
+        }
+        return g_detected_flags;
+    }
+
+    struct KernelTableRow
+    {
+        ConvertFn kernels[3];
+    };
+
+    template <SourceFormat S>
+    constexpr KernelTableRow KernelRow()
+    {
+        return {{&ConvertKernel<S, DestFormat::kI420>::Run, &ConvertKernel<S, DestFormat::kNV12>::Run,
+                 &ConvertKernel<S, DestFormat::kI444>::Run}};
+    }
+
+    // 合成屏幕内容：白底上的深色文字笔画 + 几块彩色区域（图标/图片），BGRA
+    void DrawScreen(std::vector<uint8_t> *pixels, int width, int height)
+    {
+        pixels->assign(static_cast<size_t>(width) * height * 4, 0xff);
+        for (int y = 0; y < height; ++y)
+        {
+            uint8_t *row = pixels->data() + static_cast<size_t>(y) * width * 4;
+            const bool text_row = (y % 20) >= 4 && (y % 20) < 16;
+            for (int x = 0; x < width; ++x)
+            {
+                uint8_t *p = row + x * 4;
+                if (((x / 160) + (y / 120)) % 5 == 0)
+                {
+                    p[0] = static_cast<uint8_t>(x * 3);
+                    p[1] = static_cast<uint8_t>(y * 2);
+                    p[2] = static_cast<uint8_t>(x + y);
+                }
+                else if (text_row && ((x * 7 + y * 3) % 11) < 3)
+                {
+                    p[0] = p[1] = p[2] = 24;
+                }
+            }
+        }
+    }
+} // namespace
+
+namespace convert_detail
+{
+    uint8_t *StripScratch(int width)
+    {
+        thread_local std::vector<uint8_t> scratch;
+        const size_t size = static_cast<size_t>(width) * 4 * kStripRows;
+        if (scratch.size() < size)
+            scratch.resize(size);
+        return scratch.data();
+    }
+} // namespace convert_detail
+
+const char *SourceFormatName(SourceFormat format)
+{
+    switch (format)
+    {
+    case SourceFormat::kBGRA:
+        return "BGRA";
+    case SourceFormat::kRGBA:
+        return "RGBA";
+    case SourceFormat::kABGR:
+        return "ABGR";
+    case SourceFormat::kNV12:
+        return "NV12";
+    }
+    return "unknown";
+}
+
+const char *DestFormatName(DestFormat format)
+{
+    switch (format)
+    {
+    case DestFormat::kI420:
+        return "I420";
+    case DestFormat::kNV12:
+        return "NV12";
+    case DestFormat::kI444:
+        return "I444";
+    }
+    return "unknown";
+}
+
+std::optional<SourceFormat> SourceFormatFromFourCC(uint32_t fourcc)
+{
+    switch (fourcc)
+    {
+    case webrtc::FOURCC_ARGB:
+        return SourceFormat::kBGRA;
+    case webrtc::FOURCC_ABGR:
+        return SourceFormat::kRGBA;
+    case webrtc::FOURCC_RGBA:
+        return SourceFormat::kABGR;
+    case webrtc::FOURCC_NV12:
+        return SourceFormat::kNV12;
+    default:
+        return std::nullopt;
+    }
+}
+
+webrtc::DesktopRect AlignedCrop(const webrtc::DesktopSize &size, int alignment)
+{
+    auto align = [alignment](int length)
+    {
+        const int aligned = alignment > 1 ? length / alignment * alignment : length;
+        if (aligned > 0)
+            return aligned;
+        return length > 1 ? length & ~1 : length;
+    };
+    const int width = align(size.width());
+    const int height = align(size.height());
+    return webrtc::DesktopRect::MakeXYWH(((size.width() - width) / 2) & ~1, ((size.height() - height) / 2) & ~1, width,
+                                         height);
+}
+
+ConvertSource CropSource(const ConvertSource &src, SourceFormat format, const webrtc::DesktopRect &crop)
+{
+    ConvertSource cropped = src;
+    const int bytes_per_pixel = format == SourceFormat::kNV12 ? 1 : 4;
+    cropped.data += static_cast<ptrdiff_t>(crop.top()) * src.stride + crop.left() * bytes_per_pixel;
+    if (cropped.uv)
+        cropped.uv += static_cast<ptrdiff_t>(crop.top() / 2) * src.uv_stride + crop.left() / 2 * 2;
+    cropped.width = crop.width();
+    cropped.height = crop.height();
+    return cropped;
+}
+
+void FillMaskRects(const ConvertDest &dst, DestFormat format, int width, int height,
+                   const std::vector<webrtc::DesktopRect> &rects)
+{
+    constexpr uint32_t kBlackY = 16;
+    constexpr uint32_t kBlackUV = 128;
+    for (webrtc::DesktopRect rect : rects)
+    {
+        rect.IntersectWith(webrtc::DesktopRect::MakeWH(width, height));
+        if (rect.is_empty())
+            continue;
+        if (format == DestFormat::kI444)
+        {
+            const ptrdiff_t offset_y = static_cast<ptrdiff_t>(rect.top()) * dst.stride_y + rect.left();
+            libyuv::SetPlane(dst.y + offset_y, dst.stride_y, rect.width(), rect.height(), kBlackY);
+            libyuv::SetPlane(dst.u + static_cast<ptrdiff_t>(rect.top()) * dst.stride_u + rect.left(), dst.stride_u,
+                             rect.width(), rect.height(), kBlackUV);
+            libyuv::SetPlane(dst.v + static_cast<ptrdiff_t>(rect.top()) * dst.stride_v + rect.left(), dst.stride_v,
+                             rect.width(), rect.height(), kBlackUV);
+            continue;
+        }
+        // 扩到偶数边界，色度样本对应的 2x2 亮度块都在遮挡范围内
+        const int left = rect.left() & ~1;
+        const int top = rect.top() & ~1;
+        const int right = std::min(width, (rect.right() + 1) & ~1);
+        const int bottom = std::min(height, (rect.bottom() + 1) & ~1);
+        libyuv::SetPlane(dst.y + static_cast<ptrdiff_t>(top) * dst.stride_y + left, dst.stride_y, right - left,
+                         bottom - top, kBlackY);
+        const int chroma_x = left / 2;
+        const int chroma_y = top / 2;
+        const int chroma_width = (right + 1) / 2 - chroma_x;
+        const int chroma_height = (bottom + 1) / 2 - chroma_y;
+        if (format == DestFormat::kNV12)
+        {
+            libyuv::SetPlane(dst.u + static_cast<ptrdiff_t>(chroma_y) * dst.stride_u + chroma_x * 2, dst.stride_u,
+                             chroma_width * 2, chroma_height, kBlackUV);
+            continue;
+        }
+        libyuv::SetPlane(dst.u + static_cast<ptrdiff_t>(chroma_y) * dst.stride_u + chroma_x, dst.stride_u,
+                         chroma_width, chroma_height, kBlackUV);
+        libyuv::SetPlane(dst.v + static_cast<ptrdiff_t>(chroma_y) * dst.stride_v + chroma_x, dst.stride_v,
+                         chroma_width, chroma_height, kBlackUV);
+    }
+}
+
+ConvertFn GetConvertKernel(SourceFormat src, DestFormat dst)
+{
+    // 下标与 SourceFormat / DestFormat 的枚举顺序一致
+    static constexpr KernelTableRow kKernels[] = {
+        KernelRow<SourceFormat::kBGRA>(),
+        KernelRow<SourceFormat::kRGBA>(),
+        KernelRow<SourceFormat::kABGR>(),
+        {{&ConvertKernel<SourceFormat::kNV12, DestFormat::kI420>::Run,
+          &ConvertKernel<SourceFormat::kNV12, DestFormat::kNV12>::Run, nullptr}},
+    };
+    return kKernels[static_cast<int>(src)].kernels[static_cast<int>(dst)];
+}
+
+std::string InitConvertKernels(const std::string &isa)
+{
+    const int flags = DetectedFlags();
+    const std::vector<IsaLevel> levels = AvailableLevels(flags);
+    const IsaLevel *selected = &levels.back();
+    for (const IsaLevel &level : levels)
+        if (isa == level.name)
+            selected = &level;
+    if (isa != "auto" && isa != selected->name)
+        RTC_LOG(LS_WARNING) << "[CONVERT] ISA level " << isa << " unavailable here, using " << selected->name;
+
+    std::lock_guard<std::mutex> lock(g_isa_mutex);
+    libyuv::MaskCpuFlags(selected->mask);
+    g_isa = selected->name;
+    g_isa_mask = selected->mask;
+    char hex[16];
+    snprintf(hex, sizeof(hex), "0x%x", flags);
+    RTC_LOG(LS_INFO) << "[CONVERT] libyuv cpu flags " << hex << ", using " << g_isa;
+    return g_isa;
+}
+
+std::string ConvertIsa()
+{
+    std::lock_guard<std::mutex> lock(g_isa_mutex);
+    return g_isa;
+}
+
+std::vector<std::string> AvailableConvertIsas()
+{
+    std::vector<std::string> names;
+    for (const IsaLevel &level : AvailableLevels(DetectedFlags()))
+        names.push_back(level.name);
+    return names;
+}
+
+std::vector<ConvertBenchmarkResult> RunConvertBenchmark(int width, int height, int frames)
+{
+    constexpr SourceFormat kSources[] = {SourceFormat::kBGRA, SourceFormat::kRGBA, SourceFormat::kABGR};
+    constexpr DestFormat kDests[] = {DestFormat::kI420, DestFormat::kNV12, DestFormat::kI444};
+    frames = std::max(1, frames);
+
+    std::vector<uint8_t> src_pixels;
+    DrawScreen(&src_pixels, width, height);
+    // 目标缓冲按 4:4:4 分配，三种目标格式都够用
+    const size_t plane = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> dst_pixels(plane * 3);
+    ConvertSource src{src_pixels.data(), width * 4, nullptr, 0, width, height};
+    // 典型的遮挡：密码管理器、聊天窗口和一个通知弹窗，故意放在奇数坐标上
+    const std::vector<webrtc::DesktopRect> masks = {
+        webrtc::DesktopRect::MakeXYWH(width / 10 + 1, height / 8 + 1, width / 4, height / 3),
+        webrtc::DesktopRect::MakeXYWH(width / 2 + 3, height / 3, width / 3, height / 3 + 1),
+        webrtc::DesktopRect::MakeXYWH(width - width / 5, 7, width / 5 - 9, height / 10),
+    };
+
+    std::vector<ConvertBenchmarkResult> results;
+    for (const IsaLevel &level : AvailableLevels(DetectedFlags()))
+    {
+        libyuv::MaskCpuFlags(level.mask);
+        for (SourceFormat s : kSources)
+        {
+            for (DestFormat d : kDests)
+            {
+                ConvertFn kernel = GetConvertKernel(s, d);
+                const bool full_chroma = d == DestFormat::kI444;
+                const int chroma_width = full_chroma ? width : (width + 1) / 2;
+                ConvertDest dst{dst_pixels.data(), width, dst_pixels.data() + plane, full_chroma ? width : chroma_width,
+                                dst_pixels.data() + plane * 2, full_chroma ? width : chroma_width};
+                if (d == DestFormat::kNV12)
+                {
+                    dst.stride_u = chroma_width * 2;
+                    dst.v = nullptr;
+                    dst.stride_v = 0;
+                }
+                kernel(src, dst); // 预热缓存和 libyuv 的行函数选择
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < frames; ++i)
+                    kernel(src, dst);
+                const double ms =
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+                const auto mask_start = std::chrono::steady_clock::now();
+                for (int i = 0; i < frames; ++i)
+                    FillMaskRects(dst, d, width, height, masks);
+                const double mask_ms =
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mask_start).count() /
+                    frames;
+
+                ConvertBenchmarkResult result{s, d, level.name};
+                result.ms_per_frame = ms;
+                result.mpix_per_s = ms > 0 ? plane / (ms * 1000.0) : 0;
+                result.mask_ms_per_frame = mask_ms;
+                results.push_back(result);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_isa_mutex);
+    libyuv::MaskCpuFlags(g_isa_mask);
+    return results;
+}
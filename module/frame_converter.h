@@ -0,0 +1,210 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "libyuv.h"
+#include "modules/desktop_capture/desktop_geometry.h"
+
+// 采集帧的像素格式，按内存字节序命名。libyuv 按小端整数命名，名字与内存顺序相反：
+// 内存 BGRA 在 libyuv 里是 ARGB（DesktopFrame 的默认格式 FOURCC_ARGB），内存 RGBA 是 libyuv ABGR，
+// 内存 ABGR 是 libyuv RGBA
+enum class SourceFormat
+{
+    kBGRA,
+    kRGBA,
+    kABGR,
+    kNV12, // PipeWire 直接映射的 NV12 平面（PipeWireMappedFrame）
+};
+
+enum class DestFormat
+{
+    kI420,
+    kNV12,
+    kI444,
+};
+
+const char *SourceFormatName(SourceFormat format);
+const char *DestFormatName(DestFormat format);
+// DesktopFrame::pixel_format() 到 SourceFormat，不支持的格式返回 nullopt
+std::optional<SourceFormat> SourceFormatFromFourCC(uint32_t fourcc);
+
+struct ConvertSource
+{
+    const uint8_t *data{nullptr}; // 4 字节像素；NV12 时为 Y 平面
+    int stride{0};
+    const uint8_t *uv{nullptr}; // 仅 NV12
+    int uv_stride{0};
+    int width{0};
+    int height{0};
+};
+
+struct ConvertDest
+{
+    uint8_t *y{nullptr};
+    int stride_y{0};
+    uint8_t *u{nullptr}; // NV12 时为交错的 UV 平面
+    int stride_u{0};
+    uint8_t *v{nullptr}; // NV12 时不用
+    int stride_v{0};
+};
+
+namespace convert_detail
+{
+    // 每种源格式直接可用的 libyuv 平面函数，libyuv 没有的组合为 nullptr，改走“分条转成 ARGB”
+    template <SourceFormat S>
+    struct SourceTraits;
+
+    template <>
+    struct SourceTraits<SourceFormat::kBGRA>
+    {
+        static constexpr auto kToI420 = &libyuv::ARGBToI420;
+        static constexpr auto kToNV12 = &libyuv::ARGBToNV12;
+        static constexpr auto kToI444 = &libyuv::ARGBToI444;
+        static constexpr std::nullptr_t kToARGB = nullptr;
+    };
+
+    template <>
+    struct SourceTraits<SourceFormat::kRGBA>
+    {
+        static constexpr auto kToI420 = &libyuv::ABGRToI420;
+        static constexpr auto kToNV12 = &libyuv::ABGRToNV12;
+        static constexpr std::nullptr_t kToI444 = nullptr;
+        static constexpr auto kToARGB = &libyuv::ABGRToARGB;
+    };
+
+    template <>
+    struct SourceTraits<SourceFormat::kABGR>
+    {
+        static constexpr auto kToI420 = &libyuv::RGBAToI420;
+        static constexpr std::nullptr_t kToNV12 = nullptr;
+        static constexpr std::nullptr_t kToI444 = nullptr;
+        static constexpr auto kToARGB = &libyuv::RGBAToARGB;
+    };
+
+    template <typename Fn>
+    constexpr bool kHas = !std::is_null_pointer_v<Fn>;
+
+    template <DestFormat D>
+    bool FromArgb(const uint8_t *argb, int stride, const ConvertDest &dst, int width, int height)
+    {
+        if constexpr (D == DestFormat::kI420)
+            return libyuv::ARGBToI420(argb, stride, dst.y, dst.stride_y, dst.u, dst.stride_u, dst.v, dst.stride_v,
+                                      width, height) == 0;
+        else if constexpr (D == DestFormat::kNV12)
+            return libyuv::ARGBToNV12(argb, stride, dst.y, dst.stride_y, dst.u, dst.stride_u, width, height) == 0;
+        else
+            return libyuv::ARGBToI444(argb, stride, dst.y, dst.stride_y, dst.u, dst.stride_u, dst.v, dst.stride_v,
+                                      width, height) == 0;
+    }
+
+    // 每次转 kStripRows 行到线程局部的 ARGB 暂存区再转 YUV，暂存区只有几十 KB、留在缓存里，
+    // 不需要整帧的中间缓冲
+    constexpr int kStripRows = 16; // 偶数，保证 4:2:0 色度行对齐
+    uint8_t *StripScratch(int width);
+
+    template <SourceFormat S, DestFormat D>
+    bool ViaArgbStrips(const ConvertSource &src, const ConvertDest &dst)
+    {
+        uint8_t *scratch = StripScratch(src.width);
+        const int scratch_stride = src.width * 4;
+        const int chroma_shift = D == DestFormat::kI444 ? 0 : 1;
+        for (int row = 0; row < src.height; row += kStripRows)
+        {
+            const int rows = std::min(kStripRows, src.height - row);
+            const int chroma_row = row >> chroma_shift;
+            SourceTraits<S>::kToARGB(src.data + static_cast<ptrdiff_t>(row) * src.stride, src.stride, scratch,
+                                     scratch_stride, src.width, rows);
+            ConvertDest strip = dst;
+            strip.y += static_cast<ptrdiff_t>(row) * dst.stride_y;
+            strip.u += static_cast<ptrdiff_t>(chroma_row) * dst.stride_u;
+            if (strip.v)
+                strip.v += static_cast<ptrdiff_t>(chroma_row) * dst.stride_v;
+            if (!FromArgb<D>(scratch, scratch_stride, strip, src.width, rows))
+                return false;
+        }
+        return true;
+    }
+} // namespace convert_detail
+
+// 源格式和目标格式在编译期确定的转换核：直接绑定到对应的 libyuv 平面函数（不在热路径上按格式 switch），
+// libyuv 没有直接函数的组合分条转成 ARGB 再转。libyuv 平面函数内部按 cpu_id 检测结果
+// （InitConvertKernels 时确定）挑选 SSSE3/AVX2/AVX-512/NEON 行函数
+template <SourceFormat S, DestFormat D>
+struct ConvertKernel
+{
+    static bool Run(const ConvertSource &src, const ConvertDest &dst)
+    {
+        using namespace convert_detail;
+        if constexpr (S == SourceFormat::kNV12)
+        {
+            if constexpr (D == DestFormat::kI420)
+                return libyuv::NV12ToI420(src.data, src.stride, src.uv, src.uv_stride, dst.y, dst.stride_y, dst.u,
+                                          dst.stride_u, dst.v, dst.stride_v, src.width, src.height) == 0;
+            else if constexpr (D == DestFormat::kNV12)
+            {
+                libyuv::CopyPlane(src.data, src.stride, dst.y, dst.stride_y, src.width, src.height);
+                libyuv::CopyPlane(src.uv, src.uv_stride, dst.u, dst.stride_u, (src.width + 1) / 2 * 2,
+                                  (src.height + 1) / 2);
+                return true;
+            }
+            else
+                return false; // 色度已经丢失，升采样到 4:4:4 没有意义
+        }
+        else if constexpr (D == DestFormat::kI420 && kHas<decltype(SourceTraits<S>::kToI420)>)
+            return SourceTraits<S>::kToI420(src.data, src.stride, dst.y, dst.stride_y, dst.u, dst.stride_u, dst.v,
+                                            dst.stride_v, src.width, src.height) == 0;
+        else if constexpr (D == DestFormat::kNV12 && kHas<decltype(SourceTraits<S>::kToNV12)>)
+            return SourceTraits<S>::kToNV12(src.data, src.stride, dst.y, dst.stride_y, dst.u, dst.stride_u, src.width,
+                                            src.height) == 0;
+        else if constexpr (D == DestFormat::kI444 && kHas<decltype(SourceTraits<S>::kToI444)>)
+            return SourceTraits<S>::kToI444(src.data, src.stride, dst.y, dst.stride_y, dst.u, dst.stride_u, dst.v,
+                                            dst.stride_v, src.width, src.height) == 0;
+        else
+            return ViaArgbStrips<S, D>(src, dst);
+    }
+};
+
+// 宽高向下取整到 alignment 的倍数后居中裁剪的区域，偏移取偶数保证 4:2:0 色度对齐。
+// 尺寸比 alignment 还小时只对齐到 2
+webrtc::DesktopRect AlignedCrop(const webrtc::DesktopSize &size, int alignment);
+// 把裁剪合并进转换：只移动源指针、改宽高，转换核直接读裁剪后的区域，不额外拷贝
+ConvertSource CropSource(const ConvertSource &src, SourceFormat format, const webrtc::DesktopRect &crop);
+
+// 隐私遮挡：在转换输出里把 rects（输出坐标）涂成黑色（Y=16、U=V=128），只写遮挡区域内的像素，
+// 紧跟在转换核之后、目标缓冲还在缓存里时执行，不是额外的整帧遍历。
+// 4:2:0 / NV12 时矩形向外扩到偶数边界，保证色度也完全覆盖
+void FillMaskRects(const ConvertDest &dst, DestFormat format, int width, int height,
+                   const std::vector<webrtc::DesktopRect> &rects);
+
+using ConvertFn = bool (*)(const ConvertSource &, const ConvertDest &);
+// 运行时按格式取编译期特化好的转换核（查表），不支持的组合返回 nullptr
+ConvertFn GetConvertKernel(SourceFormat src, DestFormat dst);
+
+// 启动时调用一次：触发 libyuv 的 CPU 特性检测并按 isa 限制可用指令集。
+// "auto" 使用检测到的全部特性；"c" / "sse2" / "ssse3" / "avx2" / "avx512"（x86）、"neon" / "sve"（ARM）
+// 限制到该级别，例如 AVX-512 降频时 AVX2 反而更快（用 convert_bench 在目标机器上确认）。
+// 本机不支持或无法识别的级别按 "auto" 处理。返回实际生效的级别
+std::string InitConvertKernels(const std::string &isa = "auto");
+// 当前生效的指令集级别
+std::string ConvertIsa();
+// 本机可用的级别，从低到高，第一个总是 "c"
+std::vector<std::string> AvailableConvertIsas();
+
+struct ConvertBenchmarkResult
+{
+    SourceFormat src;
+    DestFormat dst;
+    std::string isa;
+    double ms_per_frame{0};
+    double mpix_per_s{0};
+    double mask_ms_per_frame{0}; // 同一帧上 FillMaskRects 遮挡三个窗口（约 20% 面积）的耗时
+};
+
+// 用合成的屏幕内容（白底文字 + 彩色块）在每个可用指令集级别上测每个转换核和隐私遮挡，
+// 结束后恢复 InitConvertKernels 设置的级别。期间会修改 libyuv 的全局 CPU 标志，不要与转换线程同时运行
+std::vector<ConvertBenchmarkResult> RunConvertBenchmark(int width, int height, int frames);
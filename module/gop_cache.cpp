@@ -0,0 +1,54 @@
+#include "gop_cache.h"
+
+GopCache::GopCache(size_t max_bytes, size_t max_frames)
+    : max_bytes_(max_bytes), max_frames_(max_frames)
+{
+}
+
+void GopCache::OnEncodedImage(const webrtc::EncodedImage &image, const webrtc::CodecSpecificInfo *codec_info)
+{
+    if (max_frames_ == 0)
+        return;
+    // SVC 时一个关键帧由多个空域层组成，以最低层作为 GOP 的起点
+    const bool gop_start = image.FrameType() == webrtc::VideoFrameType::kVideoFrameKey &&
+                           image.SpatialIndex().value_or(0) == 0;
+    if (gop_start)
+    {
+        Clear();
+        valid_ = true;
+    }
+    if (!valid_)
+        return;
+
+    if (bytes_ + image.size() > max_bytes_ || frames_.size() >= max_frames_)
+    {
+        // GOP 太长，缓存作废，等下一个关键帧
+        Clear();
+        overflows_++;
+        return;
+    }
+
+    // 编码器可能复用输出缓冲区，缓存里保存一份独立的数据
+    CachedEncodedFrame frame;
+    frame.image = image;
+    frame.image.SetEncodedData(webrtc::EncodedImageBuffer::Create(image.data(), image.size()));
+    if (codec_info)
+        frame.codec_info = *codec_info;
+    bytes_ += image.size();
+    frames_.push_back(std::move(frame));
+}
+
+bool GopCache::Snapshot(std::vector<CachedEncodedFrame> *out) const
+{
+    if (!valid_ || frames_.empty())
+        return false;
+    *out = frames_;
+    return true;
+}
+
+void GopCache::Clear()
+{
+    frames_.clear();
+    bytes_ = 0;
+    valid_ = false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "api/video/encoded_image.h"
+#include "modules/video_coding/include/video_codec_interface.h"
+
+// 一帧编码输出及其 codec 信息（VP8/VP9 的 picture id、时域层等由 RtpSender 各自生成）
+struct CachedEncodedFrame
+{
+    webrtc::EncodedImage image;
+    std::optional<webrtc::CodecSpecificInfo> codec_info;
+};
+
+// 缓存最近一个 GOP：最新的关键帧 + 之后的所有增量帧。新观看端先收到这一段就能立即解码，
+// 再接着跟实时流。超出内存预算时整段作废，直到下一个关键帧（屏幕共享的编码器不会定期出关键帧，
+// 由使用方在 overflows() 增加时主动请求关键帧重新填充）。
+class GopCache
+{
+public:
+    // max_frames 为 0 表示不缓存
+    GopCache(size_t max_bytes, size_t max_frames);
+
+    void OnEncodedImage(const webrtc::EncodedImage &image, const webrtc::CodecSpecificInfo *codec_info);
+    // 有完整 GOP 时返回 true 并复制出来（编码数据是引用计数的，不拷贝内存）
+    bool Snapshot(std::vector<CachedEncodedFrame> *out) const;
+    void Clear();
+
+    bool valid() const { return valid_; }
+    size_t bytes() const { return bytes_; }
+    size_t frames() const { return frames_.size(); }
+    // 因超出预算而作废的次数
+    uint64_t overflows() const { return overflows_; }
+
+private:
+    const size_t max_bytes_;
+    const size_t max_frames_;
+    std::vector<CachedEncodedFrame> frames_;
+    size_t bytes_{0};
+    bool valid_{false};
+    uint64_t overflows_{0};
+};
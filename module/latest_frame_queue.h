@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+// 单生产者/单消费者的无锁帧队列，容量为 1、新帧覆盖旧帧（latest frame wins）：
+// 消费者处理不过来时丢弃还没取走的旧帧而不是排队，生产者永远不会被消费者阻塞。
+// 实现为三缓冲：生产者写 back 槽后与 middle 交换，消费者取帧时把 front 与 middle 交换；
+// 状态（middle 下标、是否有新帧、是否已关闭）放在一个原子变量里，Pop 用 atomic::wait 等待新帧。
+// 被覆盖的帧由生产者在 Push 里立即释放，不会滞留在槽里。
+template <typename T>
+class LatestFrameQueue
+{
+public:
+    LatestFrameQueue() { Reset(); }
+
+    LatestFrameQueue(const LatestFrameQueue &) = delete;
+    LatestFrameQueue &operator=(const LatestFrameQueue &) = delete;
+
+    // 生产者线程。返回 false 表示覆盖（丢弃）了一个消费者还没取走的帧
+    bool Push(T value)
+    {
+        slots_[back_] = std::move(value);
+        uint32_t prev = state_.load(std::memory_order_relaxed);
+        while (!state_.compare_exchange_weak(prev, back_ | kFresh | (prev & kClosed), std::memory_order_acq_rel,
+                                             std::memory_order_relaxed))
+        {
+        }
+        back_ = prev & kIndexMask;
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        const bool dropped = prev & kFresh;
+        if (dropped)
+        {
+            slots_[back_].reset();
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        state_.notify_one();
+        return !dropped;
+    }
+
+    // 消费者线程，没有新帧时立即返回 nullopt
+    std::optional<T> TryPop()
+    {
+        uint32_t prev = state_.load(std::memory_order_relaxed);
+        do
+        {
+            if (!(prev & kFresh))
+                return std::nullopt;
+        } while (!state_.compare_exchange_weak(prev, front_ | (prev & kClosed), std::memory_order_acq_rel,
+                                               std::memory_order_relaxed));
+        front_ = prev & kIndexMask;
+        std::optional<T> value = std::move(slots_[front_]);
+        slots_[front_].reset();
+        popped_.fetch_add(1, std::memory_order_relaxed);
+        return value;
+    }
+
+    // 消费者线程，阻塞到有新帧；Close 之后返回 nullopt
+    std::optional<T> Pop()
+    {
+        while (true)
+        {
+            if (auto value = TryPop())
+                return value;
+            const uint32_t state = state_.load(std::memory_order_acquire);
+            if (state & kClosed)
+                return std::nullopt;
+            if (!(state & kFresh))
+                state_.wait(state, std::memory_order_acquire);
+        }
+    }
+
+    // 唤醒并结束阻塞中的 Pop
+    void Close()
+    {
+        state_.fetch_or(kClosed, std::memory_order_acq_rel);
+        state_.notify_all();
+    }
+
+    // 两端线程都已退出时调用，清空并重新打开
+    void Reset()
+    {
+        for (auto &slot : slots_)
+            slot.reset();
+        front_ = 0;
+        state_.store(1, std::memory_order_release);
+        back_ = 2;
+    }
+
+    // 当前排队帧数（0 或 1）
+    int depth() const { return (state_.load(std::memory_order_relaxed) & kFresh) ? 1 : 0; }
+    uint64_t pushed() const { return pushed_.load(std::memory_order_relaxed); }
+    uint64_t popped() const { return popped_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t kIndexMask = 0x3;
+    static constexpr uint32_t kFresh = 0x4;
+    static constexpr uint32_t kClosed = 0x8;
+
+    std::optional<T> slots_[3];
+    uint32_t front_{0}; // 只由消费者访问
+    uint32_t back_{2};  // 只由生产者访问
+    std::atomic<uint32_t> state_{1};
+
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> popped_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
@@ -0,0 +1,80 @@
+#include "peer_connection_pool.h"
+
+#include "rtc_base/time_utils.h"
+
+PeerConnectionPool::PeerConnectionPool(const VideoSendConfig &config, std::vector<IceServerConfig> ice_servers,
+                                       size_t size)
+    : config_(config), ice_servers_(std::move(ice_servers)), size_(size)
+{
+    if (size_ > 0)
+        thread_ = std::thread(&PeerConnectionPool::Loop, this);
+}
+
+PeerConnectionPool::~PeerConnectionPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+    ready_.clear();
+}
+
+std::shared_ptr<WebRTCPushClient> PeerConnectionPool::Acquire()
+{
+    std::shared_ptr<WebRTCPushClient> client;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ready_.empty())
+        {
+            client = std::move(ready_.front());
+            ready_.pop_front();
+        }
+    }
+    if (!client)
+    {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    // 取走一个后立即在后台补上
+    cv_.notify_one();
+    return client;
+}
+
+void PeerConnectionPool::Loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cv_.wait(lock, [this]()
+                 { return !running_ || ready_.size() < size_; });
+        if (!running_)
+            break;
+
+        // Prepare 要创建线程和 factory，比较慢，不持锁
+        lock.unlock();
+        const int64_t start_ms = webrtc::TimeMillis();
+        auto client = std::make_shared<WebRTCPushClient>("");
+        client->SetVideoSendConfig(config_);
+        const bool ok = client->Prepare(ice_servers_);
+        lock.lock();
+
+        if (!ok)
+        {
+            RTC_LOG(LS_ERROR) << "[POOL] prepare failed, retry later";
+            // 析构会等待 WebRTC 线程退出，同样不持锁
+            lock.unlock();
+            client.reset();
+            lock.lock();
+            cv_.wait_for(lock, std::chrono::seconds(5), [this]()
+                         { return !running_; });
+            continue;
+        }
+        ready_.push_back(std::move(client));
+        RTC_LOG(LS_INFO) << "[POOL] pre-warmed connection ready in " << webrtc::TimeMillis() - start_ms
+                         << " ms (" << ready_.size() << "/" << size_ << ")";
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pushclient.h"
+
+// 预热的推流连接池：后台线程保持 size 个已经 Prepare 的 WebRTCPushClient
+// （factory、PeerConnection、视频轨和 transceiver 都已创建，ICE 候选已开始收集），
+// 新观看端到来时直接取一个 Activate，省掉建连前的初始化耗时。
+class PeerConnectionPool
+{
+public:
+    PeerConnectionPool(const VideoSendConfig &config, std::vector<IceServerConfig> ice_servers, size_t size);
+    ~PeerConnectionPool();
+
+    // 取出一个预热好的连接（未 Activate），池为空时返回 nullptr，由调用方现场创建
+    std::shared_ptr<WebRTCPushClient> Acquire();
+
+    uint64_t hits() const { return hits_.load(); }
+    uint64_t misses() const { return misses_.load(); }
+
+private:
+    void Loop();
+
+    const VideoSendConfig config_;
+    const std::vector<IceServerConfig> ice_servers_;
+    const size_t size_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<WebRTCPushClient>> ready_;
+    bool running_{true};
+    std::thread thread_;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
@@ -0,0 +1,109 @@
+#include "pipewire_capturer.h"
+#if defined(WEBRTC_USE_PIPEWIRE)
+
+#include "modules/desktop_capture/desktop_capture_options.h"
+#include "modules/desktop_capture/linux/wayland/base_capturer_pipewire.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+PipeWireNodeCapturer::PipeWireNodeCapturer(uint32_t node_id, int fps)
+    : node_id_(node_id), stream_(node_id, fps)
+{
+}
+
+PipeWireNodeCapturer::~PipeWireNodeCapturer() = default;
+
+void PipeWireNodeCapturer::Start(Callback *callback)
+{
+    callback_ = callback;
+    // 在采集线程启动，EGL 上下文（平铺 DMA-BUF 的导入）也建在这个线程
+    started_ = stream_.Start();
+    if (!started_)
+    {
+        RTC_LOG(LS_ERROR) << "[PIPEWIRE] failed to connect to node " << node_id_;
+        return;
+    }
+    RTC_LOG(LS_INFO) << "[PIPEWIRE] streaming from node " << node_id_;
+}
+
+void PipeWireNodeCapturer::CaptureFrame()
+{
+    if (!started_)
+    {
+        callback_->OnCaptureResult(Result::ERROR_PERMANENT, nullptr);
+        return;
+    }
+    callback_->OnFrameCaptureStart();
+    std::unique_ptr<webrtc::DesktopFrame> frame = stream_.TakeFrame();
+    if (frame)
+    {
+        last_frame_ = std::move(frame);
+        last_frame_ms_ = webrtc::TimeMillis();
+        frame = RepeatLastFrame();
+        // 新帧的变化区域只属于这一帧，之后的重发帧没有变化区域
+        frame->mutable_updated_region()->Swap(last_frame_->mutable_updated_region());
+        frame->set_capture_time_ms(last_frame_->capture_time_ms());
+    }
+    else if (last_frame_ && webrtc::TimeMillis() - last_frame_ms_ >= kRepeatIntervalMs)
+    {
+        last_frame_ms_ = webrtc::TimeMillis();
+        frame = RepeatLastFrame();
+    }
+    // 流还没协商好格式，或者刚交出过帧、还不到重发的时间
+    if (!frame)
+    {
+        callback_->OnCaptureResult(Result::ERROR_TEMPORARY, nullptr);
+        return;
+    }
+    callback_->OnCaptureResult(Result::SUCCESS, std::move(frame));
+}
+
+std::unique_ptr<webrtc::DesktopFrame> PipeWireNodeCapturer::RepeatLastFrame()
+{
+    // 交出的是指向同一块像素的 PipeWireMappedFrame，引用 last_frame_ 保证缓冲在帧释放前不被归还；
+    // 转换阶段对 NV12 按格式 static_cast 到 PipeWireMappedFrame，所以不能用 SharedDesktopFrame 包装
+    const uint8_t *uv = nullptr;
+    int uv_stride = 0;
+    if (last_frame_->pixel_format() == webrtc::FOURCC_NV12)
+    {
+        const auto &mapped = static_cast<const PipeWireMappedFrame &>(*last_frame_);
+        uv = mapped.uv_data();
+        uv_stride = mapped.uv_stride();
+    }
+    return std::make_unique<PipeWireMappedFrame>(last_frame_->size(), last_frame_->stride(),
+                                                 last_frame_->pixel_format(), last_frame_->data(),
+                                                 const_cast<uint8_t *>(uv), uv_stride,
+                                                 [keep = last_frame_]() {});
+}
+
+bool PipeWireNodeCapturer::GetSourceList(SourceList *sources)
+{
+    sources->push_back({node_id_, "pipewire node " + std::to_string(node_id_)});
+    return true;
+}
+
+bool PipeWireNodeCapturer::SelectSource(SourceId id)
+{
+    return id == node_id_;
+}
+
+std::unique_ptr<webrtc::DesktopCapturer> CreatePipeWireCapturer(const CaptureSourceConfig &config, std::string *mode)
+{
+    if (config.pipewire_node != 0)
+    {
+        *mode = "node";
+        return std::make_unique<PipeWireNodeCapturer>(config.pipewire_node, config.fps);
+    }
+    if (!webrtc::BaseCapturerPipeWire::IsSupported())
+    {
+        RTC_LOG(LS_WARNING) << "[PIPEWIRE] not supported here (needs a Wayland session with PipeWire)";
+        return nullptr;
+    }
+    webrtc::DesktopCaptureOptions options = webrtc::DesktopCaptureOptions::CreateDefault();
+    options.set_allow_pipewire(true);
+    options.set_pipewire_use_damage_region(true);
+    options.set_detect_updated_region(config.detect_updated_region);
+    *mode = "portal";
+    return std::make_unique<webrtc::BaseCapturerPipeWire>(options, webrtc::CaptureType::kScreen);
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+#if defined(WEBRTC_USE_PIPEWIRE)
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "modules/desktop_capture/desktop_capturer.h"
+#include "pipewire_dmabuf_stream.h"
+#include "video_send_config.h"
+
+// 直接连接本机 PipeWire daemon 上的某个视频节点（不经过 xdg-desktop-portal），
+// 用于无桌面的机器上对虚拟源做测试，例如：
+//   gst-launch-1.0 videotestsrc is-live=true ! video/x-raw,format=BGRx,width=1920,height=1080 ! pipewiresink
+//   pw-cli ls Node 找到节点 id 后配置 "capture_backend": {"type": "pipewire", "node": <id>}
+// 帧由 PipeWireDmaBufStream 协商，优先 DMA-BUF（线性缓冲直接映射给转换阶段），不支持时退回共享内存。
+// 生产者只在画面变化时出帧（静止画面、按 damage 驱动的源），没有新缓冲时按较低的频率重发上一帧，
+// 画面静止时加入的观看端也能收到第一帧。
+class PipeWireNodeCapturer : public webrtc::DesktopCapturer
+{
+public:
+    PipeWireNodeCapturer(uint32_t node_id, int fps);
+    ~PipeWireNodeCapturer() override;
+
+    void Start(Callback *callback) override;
+    void CaptureFrame() override;
+    bool GetSourceList(SourceList *sources) override;
+    bool SelectSource(SourceId id) override;
+
+private:
+    // 重发上一帧的最短间隔
+    static constexpr int64_t kRepeatIntervalMs = 250;
+
+    std::unique_ptr<webrtc::DesktopFrame> RepeatLastFrame();
+
+    const uint32_t node_id_;
+    PipeWireDmaBufStream stream_;
+    Callback *callback_{nullptr};
+    bool started_{false};
+    // 最近交出的帧（持有其 PipeWire 缓冲），放在 stream_ 之后，先于它析构
+    std::shared_ptr<webrtc::DesktopFrame> last_frame_;
+    int64_t last_frame_ms_{0};
+};
+
+// 按配置创建 PipeWire 采集器：pipewire_node 非 0 时直连该节点，否则走 xdg-desktop-portal
+// （BaseCapturerPipeWire，Wayland 会话下由用户选择屏幕）。不支持时返回 nullptr，mode 返回实际路径
+std::unique_ptr<webrtc::DesktopCapturer> CreatePipeWireCapturer(const CaptureSourceConfig &config, std::string *mode);
+#endif
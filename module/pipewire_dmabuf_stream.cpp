@@ -0,0 +1,591 @@
+#include "pipewire_dmabuf_stream.h"
+#if defined(WEBRTC_USE_PIPEWIRE)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+#include <pipewire/pipewire.h>
+#include <spa/buffer/meta.h>
+#include <spa/param/video/format-utils.h>
+#include <spa/param/video/raw.h>
+#include <spa/pod/builder.h>
+
+#include "modules/desktop_capture/linux/wayland/egl_dmabuf.h"
+#include "modules/desktop_capture/linux/wayland/screencast_stream_utils.h"
+#include "modules/portal/pipewire_utils.h"
+#include "async_log_sink.h"
+#include "rtc_base/logging.h"
+
+namespace
+{
+    // drm_fourcc.h 里的取值，只用到这两个，不额外依赖 libdrm 的头文件
+    constexpr uint64_t kDrmFormatModLinear = 0;
+    constexpr uint64_t kDrmFormatModInvalid = 0x00ffffffffffffffULL;
+
+    // 屏幕内容的常见格式排在前面；NV12 一般来自虚拟源/摄像头类节点
+    constexpr uint32_t kRgbFormats[] = {SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRA};
+    constexpr int kMaxDamageRects = 16;
+
+    std::string ModifierString(uint64_t modifier)
+    {
+        char text[24];
+        snprintf(text, sizeof(text), "0x%" PRIx64, modifier);
+        return text;
+    }
+
+    const char *FormatName(uint32_t format)
+    {
+        switch (format)
+        {
+        case SPA_VIDEO_FORMAT_BGRx:
+            return "BGRx";
+        case SPA_VIDEO_FORMAT_BGRA:
+            return "BGRA";
+        case SPA_VIDEO_FORMAT_NV12:
+            return "NV12";
+        default:
+            return "unknown";
+        }
+    }
+} // namespace
+
+struct PipeWireDmaBufStream::BufferMapping
+{
+    struct Region
+    {
+        uint8_t *addr;
+        size_t size;
+        int sync_fd; // DMA-BUF 时 dup 出来做 DMA_BUF_IOCTL_SYNC，缓冲被移除后原 fd 可能已关闭
+    };
+
+    ~BufferMapping()
+    {
+        for (const Region &r : regions)
+        {
+            if (r.sync_fd >= 0)
+                close(r.sync_fd);
+            munmap(r.addr, r.size);
+        }
+    }
+
+    void SyncStart() const
+    {
+        // GPU 可能还在写，读之前同步缓存
+        for (const Region &r : regions)
+            if (r.sync_fd >= 0)
+                webrtc::SyncDmaBuf(r.sync_fd, DMA_BUF_SYNC_START);
+    }
+    void SyncEnd() const
+    {
+        for (const Region &r : regions)
+            if (r.sync_fd >= 0)
+                webrtc::SyncDmaBuf(r.sync_fd, DMA_BUF_SYNC_END);
+    }
+
+    std::vector<Region> regions;
+    uint8_t *bases[2] = {}; // 每个 spa_data 的起始地址（已加上 mapoffset）
+    size_t sizes[2] = {};   // 每个 spa_data 可读的字节数（maxsize）
+};
+
+struct PipeWireStreamEvents
+{
+    static void ParamChanged(void *data, uint32_t id, const spa_pod *format)
+    {
+        static_cast<PipeWireDmaBufStream *>(data)->OnParamChanged(id, format);
+    }
+    static void Process(void *data)
+    {
+        static_cast<PipeWireDmaBufStream *>(data)->OnProcess();
+    }
+    static void AddBuffer(void *data, pw_buffer *buffer)
+    {
+        static_cast<PipeWireDmaBufStream *>(data)->OnAddBuffer(buffer);
+    }
+    static void RemoveBuffer(void *data, pw_buffer *buffer)
+    {
+        static_cast<PipeWireDmaBufStream *>(data)->OnRemoveBuffer(buffer);
+    }
+    static void StateChanged(void *, pw_stream_state old_state, pw_stream_state state, const char *error)
+    {
+        RTC_LOG(LS_INFO) << "[PIPEWIRE] stream " << pw_stream_state_as_string(old_state) << " -> "
+                         << pw_stream_state_as_string(state);
+        if (state == PW_STREAM_STATE_ERROR)
+            RTC_LOG(LS_ERROR) << "[PIPEWIRE] stream error: " << (error ? error : "unknown");
+    }
+    static pw_stream_events Make()
+    {
+        pw_stream_events events{};
+        events.version = PW_VERSION_STREAM_EVENTS;
+        events.state_changed = &StateChanged;
+        events.param_changed = &ParamChanged;
+        events.add_buffer = &AddBuffer;
+        events.remove_buffer = &RemoveBuffer;
+        events.process = &Process;
+        return events;
+    }
+};
+
+PipeWireMappedFrame::PipeWireMappedFrame(webrtc::DesktopSize size, int stride, webrtc::FourCC pixel_format,
+                                         uint8_t *data, uint8_t *uv_data, int uv_stride,
+                                         std::function<void()> release)
+    : webrtc::DesktopFrame(size, stride, pixel_format, data, nullptr),
+      uv_data_(uv_data), uv_stride_(uv_stride), release_(std::move(release))
+{
+}
+
+PipeWireMappedFrame::~PipeWireMappedFrame()
+{
+    if (release_)
+        release_();
+}
+
+PipeWireDmaBufStream::PipeWireDmaBufStream(uint32_t node_id, int fps)
+    : node_id_(node_id), fps_(std::max(1, fps)), shared_(std::make_shared<Shared>())
+{
+}
+
+PipeWireDmaBufStream::~PipeWireDmaBufStream()
+{
+    Stop();
+}
+
+bool PipeWireDmaBufStream::Start()
+{
+    // 采集器永久失败后会被重新 Start，先回收上一次的连接；上一次交出的帧各自持有旧的 Shared
+    Stop();
+    shared_ = std::make_shared<Shared>();
+    egl_modifiers_.clear();
+    dmabuf_allowed_ = true;
+    if (!webrtc::InitializePipeWire())
+    {
+        RTC_LOG(LS_ERROR) << "[PIPEWIRE] failed to load libpipewire";
+        return false;
+    }
+    pw_initializer_ = std::make_unique<webrtc::PipeWireInitializer>();
+
+    // EGL 上下文只在当前（采集）线程可用，导入也在采集线程做；没有 GPU 时只协商线性 DMA-BUF 和共享内存
+    egl_ = std::make_unique<webrtc::EglDmaBuf>();
+    if (egl_->IsEglInitialized())
+    {
+        for (uint32_t format : kRgbFormats)
+            egl_modifiers_.emplace_back(format, egl_->QueryDmaBufModifiers(format));
+    }
+    else
+    {
+        RTC_LOG(LS_INFO) << "[PIPEWIRE] EGL unavailable, accepting linear DMA-BUF and shared memory frames only";
+    }
+
+    loop_ = pw_thread_loop_new("twebrtc-pipewire", nullptr);
+    if (!loop_)
+        return false;
+    context_ = pw_context_new(pw_thread_loop_get_loop(loop_), nullptr, 0);
+    if (!context_ || pw_thread_loop_start(loop_) < 0)
+    {
+        RTC_LOG(LS_ERROR) << "[PIPEWIRE] failed to start the PipeWire loop";
+        return false;
+    }
+
+    webrtc::PipeWireThreadLoopLock lock(loop_);
+    core_ = pw_context_connect(context_, nullptr, 0);
+    if (!core_)
+    {
+        RTC_LOG(LS_ERROR) << "[PIPEWIRE] failed to connect to the PipeWire daemon";
+        return false;
+    }
+    stream_ = pw_stream_new(core_, "twebrtc-capture",
+                            pw_properties_new(PW_KEY_MEDIA_TYPE, "Video", PW_KEY_MEDIA_CATEGORY, "Capture",
+                                              PW_KEY_MEDIA_ROLE, "Screen", nullptr));
+    if (!stream_)
+        return false;
+    static const pw_stream_events kEvents = PipeWireStreamEvents::Make();
+    pw_stream_add_listener(stream_, &stream_listener_, &kEvents, this);
+
+    uint8_t buffer[4096];
+    spa_pod_builder builder = spa_pod_builder{buffer, sizeof(buffer)};
+    std::vector<const spa_pod *> params = BuildFormats(&builder);
+    // 不用 PW_STREAM_FLAG_MAP_BUFFERS：add_buffer 时自己映射（它不映射 DMA-BUF），映射由引用计数持有，
+    // 格式重新协商时 PipeWire 回收缓冲不会影响还在转换的帧
+    if (pw_stream_connect(stream_, PW_DIRECTION_INPUT, node_id_, PW_STREAM_FLAG_AUTOCONNECT, params.data(),
+                          params.size()) != 0)
+    {
+        RTC_LOG(LS_ERROR) << "[PIPEWIRE] failed to connect stream to node " << node_id_;
+        return false;
+    }
+    shared_->loop = loop_;
+    shared_->stream = stream_;
+    return true;
+}
+
+void PipeWireDmaBufStream::Stop()
+{
+    {
+        // 之后释放的帧只解除映射，不再归还缓冲
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        shared_->alive = false;
+    }
+    if (loop_)
+        pw_thread_loop_stop(loop_);
+    if (stream_)
+    {
+        pw_stream_disconnect(stream_);
+        pw_stream_destroy(stream_);
+        stream_ = nullptr;
+    }
+    mappings_.clear();
+    if (core_)
+    {
+        pw_core_disconnect(core_);
+        core_ = nullptr;
+    }
+    if (context_)
+    {
+        pw_context_destroy(context_);
+        context_ = nullptr;
+    }
+    if (loop_)
+    {
+        pw_thread_loop_destroy(loop_);
+        loop_ = nullptr;
+    }
+    latest_ = nullptr;
+}
+
+std::vector<const spa_pod *> PipeWireDmaBufStream::BuildFormats(spa_pod_builder *builder) const
+{
+    const spa_fraction frame_rate = SPA_FRACTION(static_cast<uint32_t>(fps_), 1);
+    std::vector<const spa_pod *> params;
+    // 按偏好顺序：先带 modifier 的 DMA-BUF，再不带 modifier 的共享内存
+    if (dmabuf_allowed_)
+    {
+        for (uint32_t format : kRgbFormats)
+        {
+            // LINEAR 总是可以直接映射，其余 modifier 要 EGL 能导入
+            std::vector<uint64_t> modifiers{kDrmFormatModLinear};
+            for (const auto &[egl_format, egl_modifiers] : egl_modifiers_)
+            {
+                if (egl_format != format)
+                    continue;
+                for (uint64_t modifier : egl_modifiers)
+                    if (modifier != kDrmFormatModLinear)
+                        modifiers.push_back(modifier);
+            }
+            params.push_back(webrtc::BuildFormat(builder, format, modifiers, nullptr, &frame_rate));
+        }
+        // EglDmaBuf 只支持 RGB 格式的导入，NV12 只接受能直接映射的线性缓冲
+        params.push_back(webrtc::BuildFormat(builder, SPA_VIDEO_FORMAT_NV12, {kDrmFormatModLinear}, nullptr, &frame_rate));
+    }
+    for (uint32_t format : kRgbFormats)
+        params.push_back(webrtc::BuildFormat(builder, format, {}, nullptr, &frame_rate));
+    params.push_back(webrtc::BuildFormat(builder, SPA_VIDEO_FORMAT_NV12, {}, nullptr, &frame_rate));
+    return params;
+}
+
+void PipeWireDmaBufStream::OnParamChanged(uint32_t id, const spa_pod *format)
+{
+    if (!format || id != SPA_PARAM_Format)
+        return;
+    spa_video_info_raw info{};
+    if (spa_format_video_raw_parse(format, &info) < 0)
+    {
+        RTC_LOG(LS_ERROR) << "[PIPEWIRE] failed to parse negotiated video format";
+        return;
+    }
+    format_.spa_format = info.format;
+    format_.size = webrtc::DesktopSize(info.size.width, info.size.height);
+    format_.dmabuf = spa_pod_find_prop(format, nullptr, SPA_FORMAT_VIDEO_modifier) != nullptr;
+    format_.modifier = format_.dmabuf ? info.modifier : kDrmFormatModInvalid;
+    dmabuf_map_failed_ = false;
+    pending_full_damage_ = true;
+    RTC_LOG(LS_INFO) << "[PIPEWIRE] negotiated " << FormatName(format_.spa_format) << " " << format_.size.width() << "x"
+                     << format_.size.height()
+                     << (format_.dmabuf ? " dmabuf modifier=" + ModifierString(format_.modifier) : std::string(" shm"));
+
+    uint8_t buffer[1024];
+    spa_pod_builder builder = spa_pod_builder{buffer, sizeof(buffer)};
+    const int data_types = format_.dmabuf ? (1 << SPA_DATA_DmaBuf) : (1 << SPA_DATA_MemFd);
+    const spa_pod *params[3];
+    // 转换阶段最多同时持有两帧，加上最新帧和生产者正在写的，8 个足够
+    params[0] = reinterpret_cast<const spa_pod *>(spa_pod_builder_add_object(
+        &builder, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers, SPA_PARAM_BUFFERS_buffers,
+        SPA_POD_CHOICE_RANGE_Int(8, 2, 16), SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(data_types)));
+    params[1] = reinterpret_cast<const spa_pod *>(spa_pod_builder_add_object(
+        &builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta, SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
+        SPA_PARAM_META_size, SPA_POD_Int(static_cast<int>(sizeof(spa_meta_header)))));
+    params[2] = reinterpret_cast<const spa_pod *>(spa_pod_builder_add_object(
+        &builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta, SPA_PARAM_META_type, SPA_POD_Id(SPA_META_VideoDamage),
+        SPA_PARAM_META_size,
+        SPA_POD_CHOICE_RANGE_Int(static_cast<int>(sizeof(spa_meta_region) * kMaxDamageRects),
+                                 static_cast<int>(sizeof(spa_meta_region)),
+                                 static_cast<int>(sizeof(spa_meta_region) * kMaxDamageRects))));
+    pw_stream_update_params(stream_, params, 3);
+}
+
+void PipeWireDmaBufStream::OnProcess()
+{
+    // 只留最新的缓冲，其余立即归还；跳过的缓冲的变化区域累积到下一次交出的帧上
+    while (pw_buffer *buffer = pw_stream_dequeue_buffer(stream_))
+    {
+        spa_buffer *spa = buffer->buffer;
+        const auto *header = static_cast<const spa_meta_header *>(
+            spa_buffer_find_meta_data(spa, SPA_META_Header, sizeof(spa_meta_header)));
+        const bool usable = spa->n_datas > 0 && !(header && (header->flags & SPA_META_HEADER_FLAG_CORRUPTED)) &&
+                            !(spa->datas[0].chunk->flags & SPA_CHUNK_FLAG_CORRUPTED) &&
+                            (spa->datas[0].type == SPA_DATA_DmaBuf || spa->datas[0].chunk->size > 0);
+        if (!usable)
+        {
+            pw_stream_queue_buffer(stream_, buffer);
+            continue;
+        }
+        AccumulateDamage(buffer);
+        if (latest_)
+            pw_stream_queue_buffer(stream_, latest_);
+        latest_ = buffer;
+    }
+}
+
+void PipeWireDmaBufStream::OnAddBuffer(pw_buffer *buffer)
+{
+    // 平铺 modifier 的 DMA-BUF 只能由 EGL 导入，不映射
+    if (format_.dmabuf && format_.modifier != kDrmFormatModLinear)
+        return;
+    spa_buffer *spa = buffer->buffer;
+    const uint32_t n = std::min<uint32_t>(spa->n_datas, format_.spa_format == SPA_VIDEO_FORMAT_NV12 ? 2 : 1);
+    if (n == 0)
+        return;
+    // NV12 两个平面可能在同一个 fd 里，这时只映射一次，覆盖两个平面
+    const bool shared_fd = n == 2 && spa->datas[1].fd == spa->datas[0].fd;
+    auto mapping = std::make_shared<BufferMapping>();
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const spa_data &d = spa->datas[i];
+        if ((d.type != SPA_DATA_DmaBuf && d.type != SPA_DATA_MemFd) || d.fd < 0)
+            return;
+        mapping->sizes[i] = d.maxsize;
+        if (i == 1 && shared_fd)
+        {
+            mapping->bases[1] = mapping->regions[0].addr + d.mapoffset;
+            continue;
+        }
+        size_t size = d.mapoffset + d.maxsize;
+        if (shared_fd)
+            size = std::max<size_t>(size, spa->datas[1].mapoffset + spa->datas[1].maxsize);
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, d.fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            RTC_LOG(LS_WARNING) << "[PIPEWIRE] failed to map buffer plane " << i << " (" << size << " bytes)";
+            return;
+        }
+        mapping->regions.push_back({static_cast<uint8_t *>(addr), size, d.type == SPA_DATA_DmaBuf ? dup(d.fd) : -1});
+        mapping->bases[i] = mapping->regions.back().addr + d.mapoffset;
+    }
+    mappings_[buffer] = std::move(mapping);
+}
+
+void PipeWireDmaBufStream::OnRemoveBuffer(pw_buffer *buffer)
+{
+    if (buffer == latest_)
+        latest_ = nullptr;
+    // 已交出的帧释放时不再归还这个缓冲；映射由这些帧继续持有，最后一帧释放时解除
+    shared_->taken.erase(buffer);
+    mappings_.erase(buffer);
+}
+
+void PipeWireDmaBufStream::AccumulateDamage(pw_buffer *buffer)
+{
+    if (pending_full_damage_)
+        return;
+    spa_meta *damage = spa_buffer_find_meta(buffer->buffer, SPA_META_VideoDamage);
+    if (!damage)
+    {
+        pending_full_damage_ = true;
+        return;
+    }
+    spa_meta_region *region;
+    spa_meta_for_each(region, damage)
+    {
+        if (!spa_meta_region_is_valid(region))
+            break;
+        pending_damage_.AddRect(webrtc::DesktopRect::MakeXYWH(region->region.position.x, region->region.position.y,
+                                                              region->region.size.width, region->region.size.height));
+    }
+}
+
+std::unique_ptr<webrtc::DesktopFrame> PipeWireDmaBufStream::TakeFrame()
+{
+    if (!loop_ || !stream_)
+        return nullptr;
+    webrtc::PipeWireThreadLoopLock lock(loop_);
+    pw_buffer *buffer = std::exchange(latest_, nullptr);
+    if (!buffer)
+        return nullptr;
+    if (format_.size.is_empty())
+    {
+        QueueBuffer(buffer);
+        return nullptr;
+    }
+
+    const bool dmabuf = buffer->buffer->datas[0].type == SPA_DATA_DmaBuf;
+    const bool nv12 = format_.spa_format == SPA_VIDEO_FORMAT_NV12;
+    std::unique_ptr<webrtc::DesktopFrame> frame;
+    const char *path = dmabuf ? "dmabuf" : "shm";
+    if (!dmabuf || (format_.modifier == kDrmFormatModLinear && !dmabuf_map_failed_))
+    {
+        frame = MapBuffer(buffer);
+        if (!frame && dmabuf)
+        {
+            RTC_LOG(LS_WARNING) << "[PIPEWIRE] linear DMA-BUF cannot be mapped by the CPU on this driver";
+            dmabuf_map_failed_ = true;
+        }
+    }
+    if (!frame)
+    {
+        // 没能映射时缓冲还在手上；EGL 导入会读回到自己的缓冲里，之后就可以归还
+        if (dmabuf && !nv12)
+        {
+            frame = ImportWithEgl(buffer);
+            path = "egl";
+        }
+        QueueBuffer(buffer);
+        if (!frame)
+        {
+            if (dmabuf && dmabuf_allowed_)
+                RenegotiateWithoutDmaBuf();
+            return nullptr;
+        }
+    }
+
+    webrtc::DesktopRegion *updated = frame->mutable_updated_region();
+    if (pending_full_damage_)
+    {
+        updated->SetRect(webrtc::DesktopRect::MakeSize(format_.size));
+    }
+    else
+    {
+        updated->Swap(&pending_damage_);
+        updated->IntersectWith(webrtc::DesktopRect::MakeSize(format_.size));
+    }
+    pending_damage_.Clear();
+    pending_full_damage_ = false;
+
+    std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+    if (path_ != path)
+        RTC_LOG(LS_INFO) << "[PIPEWIRE] frames now delivered via " << path;
+    path_ = path;
+    if (path_ == "dmabuf")
+        counters_.dmabuf_frames++;
+    else if (path_ == "egl")
+        counters_.egl_frames++;
+    else
+        counters_.shm_frames++;
+    return frame;
+}
+
+std::unique_ptr<webrtc::DesktopFrame> PipeWireDmaBufStream::MapBuffer(pw_buffer *buffer)
+{
+    auto it = mappings_.find(buffer);
+    if (it == mappings_.end())
+        return nullptr;
+    std::shared_ptr<BufferMapping> mapping = it->second;
+    spa_buffer *spa = buffer->buffer;
+    const bool nv12 = format_.spa_format == SPA_VIDEO_FORMAT_NV12;
+    const int width = format_.size.width();
+    const int height = format_.size.height();
+    const uint32_t n = std::min<uint32_t>(spa->n_datas, nv12 ? 2 : 1);
+    auto stride_of = [&](const spa_data &d)
+    { return d.chunk->stride > 0 ? d.chunk->stride : (nv12 ? width : width * webrtc::DesktopFrame::kBytesPerPixel); };
+
+    // 本帧要读的范围必须落在映射内；NV12 只有一个 spa_data 时 UV 平面紧跟在 Y 平面后面
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const spa_data &d = spa->datas[i];
+        size_t rows = i == 0 ? height : (height + 1) / 2;
+        if (nv12 && n == 1)
+            rows += (height + 1) / 2;
+        if (d.chunk->offset + static_cast<size_t>(stride_of(d)) * rows > mapping->sizes[i])
+        {
+            RTC_LOG_EVERY_SEC(LS_WARNING, 1) << "[PIPEWIRE] buffer chunk exceeds its mapping, dropping frame";
+            return nullptr;
+        }
+    }
+
+    mapping->SyncStart();
+    uint8_t *y = mapping->bases[0] + spa->datas[0].chunk->offset;
+    const int y_stride = stride_of(spa->datas[0]);
+    uint8_t *uv = nullptr;
+    int uv_stride = 0;
+    if (nv12)
+    {
+        uv = n == 2 ? mapping->bases[1] + spa->datas[1].chunk->offset : y + static_cast<size_t>(y_stride) * height;
+        uv_stride = n == 2 ? stride_of(spa->datas[1]) : y_stride;
+    }
+
+    shared_->taken.insert(buffer);
+    auto release = [shared = shared_, buffer, mapping]()
+    {
+        mapping->SyncEnd();
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        if (!shared->alive)
+            return;
+        webrtc::PipeWireThreadLoopLock loop_lock(shared->loop);
+        // 重新协商格式时缓冲已被移除，不能再归还
+        if (shared->taken.erase(buffer))
+            pw_stream_queue_buffer(shared->stream, buffer);
+    };
+    return std::make_unique<PipeWireMappedFrame>(format_.size, y_stride,
+                                                 nv12 ? webrtc::FOURCC_NV12 : webrtc::FOURCC_ARGB, y, uv,
+                                                 uv_stride, std::move(release));
+}
+
+std::unique_ptr<webrtc::DesktopFrame> PipeWireDmaBufStream::ImportWithEgl(pw_buffer *buffer)
+{
+    if (!egl_ || !egl_->IsEglInitialized())
+        return nullptr;
+    spa_buffer *spa = buffer->buffer;
+    std::vector<webrtc::EglDmaBuf::PlaneData> planes;
+    for (uint32_t i = 0; i < spa->n_datas; ++i)
+    {
+        planes.push_back({static_cast<int32_t>(spa->datas[i].fd), static_cast<uint32_t>(spa->datas[i].chunk->stride),
+                          spa->datas[i].chunk->offset});
+    }
+    auto frame = std::make_unique<webrtc::BasicDesktopFrame>(format_.size, webrtc::FOURCC_ARGB);
+    if (!egl_->ImageFromDmaBuf(format_.size, format_.spa_format, planes, format_.modifier, webrtc::DesktopVector(0, 0),
+                               format_.size, frame->data()))
+    {
+        RTC_LOG_EVERY_SEC(LS_WARNING, 1) << "[PIPEWIRE] EGL failed to import DMA-BUF modifier "
+                                         << ModifierString(format_.modifier);
+        return nullptr;
+    }
+    return frame;
+}
+
+void PipeWireDmaBufStream::QueueBuffer(pw_buffer *buffer)
+{
+    pw_stream_queue_buffer(stream_, buffer);
+}
+
+void PipeWireDmaBufStream::RenegotiateWithoutDmaBuf()
+{
+    RTC_LOG(LS_WARNING) << "[PIPEWIRE] DMA-BUF frames can be neither mapped nor imported, falling back to shared memory";
+    dmabuf_allowed_ = false;
+    uint8_t buffer[4096];
+    spa_pod_builder builder = spa_pod_builder{buffer, sizeof(buffer)};
+    std::vector<const spa_pod *> params = BuildFormats(&builder);
+    pw_stream_update_params(stream_, params.data(), params.size());
+}
+
+PipeWireDmaBufStream::Counters PipeWireDmaBufStream::counters() const
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return counters_;
+}
+
+std::string PipeWireDmaBufStream::path() const
+{
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return path_;
+}
+#endif
@@ -0,0 +1,147 @@
+#pragma once
+#if defined(WEBRTC_USE_PIPEWIRE)
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <spa/utils/hook.h>
+
+#include "modules/desktop_capture/desktop_frame.h"
+#include "modules/desktop_capture/desktop_region.h"
+
+struct pw_buffer;
+struct pw_context;
+struct pw_core;
+struct pw_stream;
+struct pw_thread_loop;
+struct spa_pod;
+struct spa_pod_builder;
+
+namespace webrtc
+{
+    class EglDmaBuf;
+    class PipeWireInitializer;
+}
+
+// 直接指向 PipeWire 缓冲（映射后的 DMA-BUF 或共享内存）的帧，不拷贝像素，析构时把缓冲还给 PipeWire。
+// pixel_format 为 FOURCC_ARGB（BGRA/BGRx）或 FOURCC_NV12：NV12 时 data()/stride() 是 Y 平面，
+// UV 平面由 uv_data()/uv_stride() 给出。DesktopFrame 本身只约定 4 字节像素，NV12 帧只能交给
+// 按 pixel_format 分支的转换阶段（没有 RTTI，按 FOURCC_NV12 判断后 static_cast 到本类）。
+class PipeWireMappedFrame : public webrtc::DesktopFrame
+{
+public:
+    PipeWireMappedFrame(webrtc::DesktopSize size, int stride, webrtc::FourCC pixel_format, uint8_t *data,
+                        uint8_t *uv_data, int uv_stride, std::function<void()> release);
+    ~PipeWireMappedFrame() override;
+
+    const uint8_t *uv_data() const { return uv_data_; }
+    int uv_stride() const { return uv_stride_; }
+
+private:
+    uint8_t *const uv_data_;
+    const int uv_stride_;
+    std::function<void()> release_;
+};
+
+// 自己消费 PipeWire 节点的 pw_stream，替代 SharedScreenCastStream 的 DMA-BUF 处理：
+// SharedScreenCastStream 对每个 DMA-BUF 都用 EGL 导入成纹理再 glReadPixels 读回到 BGRA 缓冲，
+// 再拷贝一次到它的帧队列里。这里按缓冲类型分三条路径：
+//   dmabuf  线性（LINEAR modifier）DMA-BUF 在缓冲加入（add_buffer）时 mmap 一次，每帧只用
+//           DMA_BUF_IOCTL_SYNC 包住读取，BGRA/BGRx 和 NV12 平面原地交给转换阶段，没有中间整帧拷贝
+//   egl     平铺（tiled）modifier 只能由 GPU 解平铺，退回 EglDmaBuf 导入 + 读回
+//   shm     MemFd 共享内存（没有 GPU、llvmpipe 或生产者不支持 DMA-BUF），同样在加入时映射、原地读取
+// 线性 DMA-BUF 映射失败（驱动不支持 CPU mmap）时重新协商为只用共享内存。
+// 除构造/析构外都在采集线程调用。
+class PipeWireDmaBufStream
+{
+public:
+    struct Counters
+    {
+        uint64_t dmabuf_frames{0};
+        uint64_t egl_frames{0};
+        uint64_t shm_frames{0};
+    };
+
+    PipeWireDmaBufStream(uint32_t node_id, int fps);
+    ~PipeWireDmaBufStream();
+
+    PipeWireDmaBufStream(const PipeWireDmaBufStream &) = delete;
+    PipeWireDmaBufStream &operator=(const PipeWireDmaBufStream &) = delete;
+
+    bool Start();
+    void Stop();
+
+    // 取走最新的一帧，没有新帧时返回 nullptr。返回的帧持有 PipeWire 缓冲，应尽快释放
+    std::unique_ptr<webrtc::DesktopFrame> TakeFrame();
+
+    Counters counters() const;
+    // 最近一帧走的路径："dmabuf" / "egl" / "shm"，还没有帧时为空
+    std::string path() const;
+
+private:
+    struct Format
+    {
+        uint32_t spa_format{0};
+        webrtc::DesktopSize size;
+        bool dmabuf{false};
+        uint64_t modifier{0};
+    };
+    // 已交出的帧释放时用到的状态，可能比 PipeWireDmaBufStream 活得久
+    struct Shared
+    {
+        std::mutex mutex;
+        bool alive{true};
+        pw_thread_loop *loop{nullptr};
+        pw_stream *stream{nullptr};
+        std::set<pw_buffer *> taken; // 已交出还没归还的缓冲，受 loop 锁保护
+    };
+
+    // 一个 pw_buffer 的持久映射，缓冲移除后由还没释放的帧继续持有，最后一个引用释放时 munmap
+    struct BufferMapping;
+
+    // pw_stream 回调（定义在 .cpp，签名用到 PipeWire 头文件里的类型）
+    friend struct PipeWireStreamEvents;
+    void OnParamChanged(uint32_t id, const spa_pod *format);
+    void OnProcess();
+    void OnAddBuffer(pw_buffer *buffer);
+    void OnRemoveBuffer(pw_buffer *buffer);
+
+    std::vector<const spa_pod *> BuildFormats(spa_pod_builder *builder) const;
+    void AccumulateDamage(pw_buffer *buffer);
+    std::unique_ptr<webrtc::DesktopFrame> MapBuffer(pw_buffer *buffer);
+    std::unique_ptr<webrtc::DesktopFrame> ImportWithEgl(pw_buffer *buffer);
+    void QueueBuffer(pw_buffer *buffer);
+    void RenegotiateWithoutDmaBuf();
+
+    const uint32_t node_id_;
+    const int fps_;
+    std::shared_ptr<Shared> shared_;
+    std::unique_ptr<webrtc::PipeWireInitializer> pw_initializer_;
+    pw_thread_loop *loop_{nullptr};
+    pw_context *context_{nullptr};
+    pw_core *core_{nullptr};
+    pw_stream *stream_{nullptr};
+    spa_hook stream_listener_{};
+    std::unique_ptr<webrtc::EglDmaBuf> egl_;
+
+    // 以下受 loop 锁保护（PipeWire 回调在 loop 线程持锁执行）
+    std::vector<std::pair<uint32_t, std::vector<uint64_t>>> egl_modifiers_; // spa 格式 -> EGL 可导入的 modifier
+    bool dmabuf_allowed_{true};
+    bool dmabuf_map_failed_{false}; // 驱动不支持 CPU mmap 线性 DMA-BUF，之后都走 EGL
+    Format format_;
+    pw_buffer *latest_{nullptr};
+    std::map<pw_buffer *, std::shared_ptr<BufferMapping>> mappings_;
+    webrtc::DesktopRegion pending_damage_;
+    bool pending_full_damage_{true};
+
+    mutable std::mutex stats_mutex_;
+    Counters counters_;
+    std::string path_;
+};
+#endif
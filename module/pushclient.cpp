@@ -1,4 +1,5 @@
 #include "pushclient.h"
+#include "async_log_sink.h"
 
 #include "api/audio_options.h"
 #include "media/engine/webrtc_media_engine.h"
@@ -11,6 +12,7 @@
 #include "rtc_base/ssl_adapter.h"
 #include "libyuv.h"
 #include "api/video/i420_buffer.h"
+#include "api/video/i444_buffer.h"
 #include "api/create_modular_peer_connection_factory.h"
 #include "api/enable_media.h"
 #include "api/environment/environment.h"
@@ -26,7 +28,20 @@
 #include "api/video_codecs/video_encoder_factory_template_libvpx_vp8_adapter.h"
 #include "api/video_codecs/video_encoder_factory_template_libvpx_vp9_adapter.h"
 #include "api/video_codecs/video_encoder_factory_template_open_h264_adapter.h"
+#include "api/video_codecs/av1_profile.h"
+#include "api/video_codecs/vp9_profile.h"
 #include "rtc_base/time_utils.h"
+#include <cmath>
+#include <numeric>
+#include "api/video_codecs/scalability_mode_helper.h"
+#include "absl/strings/match.h"
+#include "codec_benchmark.h"
+#include "cpu_governor.h"
+#include "shared_encoder.h"
+
+#include <sys/resource.h>
+#include <map>
+#include <tuple>
 #include "api/stats/rtc_stats.h"
 #include "api/stats/rtc_stats_collector_callback.h"
 #include "api/stats/rtcstats_objects.h"
@@ -57,17 +72,121 @@ namespace webrtc
     };
 } // namespace webrtc
 
-webrtc::scoped_refptr<CapturerTrackSource> CapturerTrackSource::Create(int target_fps, bool capture_cursor)
+std::unique_ptr<webrtc::VideoEncoderFactory> CreateDesktopVideoEncoderFactory()
 {
-    auto src = webrtc::make_ref_counted<CapturerTrackSource>();
-    // 这里用 ScreenCapturer；如果要窗口捕获，改成 CreateWindowCapturer 并传 window id
-    webrtc::DesktopCaptureOptions options = webrtc::DesktopCaptureOptions::CreateDefault();
+    return std::make_unique<webrtc::VideoEncoderFactoryTemplate<
+        webrtc::LibvpxVp8EncoderTemplateAdapter,
+        webrtc::LibvpxVp9EncoderTemplateAdapter,
+        webrtc::OpenH264EncoderTemplateAdapter,
+        webrtc::LibaomAv1EncoderTemplateAdapter>>();
+}
+
+bool IsFullChromaCodec(const webrtc::RtpCodec &codec)
+{
+    if (absl::EqualsIgnoreCase(codec.name, "VP9"))
+        return webrtc::ParseSdpForVP9Profile(codec.parameters) == webrtc::VP9Profile::kProfile1;
+    if (absl::EqualsIgnoreCase(codec.name, "AV1"))
+        return webrtc::ParseSdpForAV1Profile(codec.parameters) == webrtc::AV1Profile::kProfile1;
+    return false;
+}
+
+namespace
+{
+    webrtc::VideoTrackInterface::ContentHint ToTrackContentHint(ContentMode mode)
+    {
+        switch (mode)
+        {
+        case ContentMode::kText:
+            return webrtc::VideoTrackInterface::ContentHint::kText;
+        case ContentMode::kFluid:
+            return webrtc::VideoTrackInterface::ContentHint::kFluid;
+        case ContentMode::kDetailed:
+        default:
+            return webrtc::VideoTrackInterface::ContentHint::kDetailed;
+        }
+    }
+
+    webrtc::DegradationPreference ToDegradationPreference(ContentMode mode)
+    {
+        // 文字/细节内容宁可掉帧也要清晰；运动内容宁可降分辨率也要流畅
+        return mode == ContentMode::kFluid ? webrtc::DegradationPreference::MAINTAIN_FRAMERATE
+                                           : webrtc::DegradationPreference::MAINTAIN_RESOLUTION;
+    }
+
+    struct SharedCaptureSource
+    {
+        webrtc::scoped_refptr<CapturerTrackSource> source;
+        int users{0};
+    };
+    // 与 DesktopCapturer::IsRunningUnderWayland 相同的判断（那个只在定义 WEBRTC_USE_X11/PIPEWIRE 时声明）
+    bool IsWaylandSession()
+    {
+        const char *session_type = getenv("XDG_SESSION_TYPE");
+        return session_type && strcmp(session_type, "wayland") == 0 && getenv("WAYLAND_DISPLAY");
+    }
+
+    std::mutex g_shared_sources_mutex;
+    std::map<std::string, SharedCaptureSource> g_shared_sources; // key: CaptureSourceConfig::Key()
+} // namespace
 
-    src->capturer_ = (webrtc::DesktopCapturer::CreateScreenCapturer(options));
+webrtc::scoped_refptr<CapturerTrackSource> CapturerTrackSource::Create(const CaptureSourceConfig &config)
+{
+    auto src = webrtc::make_ref_counted<CapturerTrackSource>();
+    src->m_iTargetFps = std::max(1, config.fps);
+    src->resolution_alignment_ = std::max(1, config.resolution_alignment);
+    if (!config.privacy_mask.empty())
+        src->SetPrivacyMask(config.privacy_mask);
+    if (!config.replay.path.empty())
+    {
+        // 转储文件里带有录制时的变化区域，detect_updated_region 不需要额外处理
+        src->capturer_ = ReplayDesktopCapturer::Create(config.replay);
+        if (!src->capturer_)
+            return nullptr;
+        src->self_paced_ = true;
+        src->backend_.backend = "replay";
+        src->backend_.mode = config.replay.realtime ? "realtime" : "fast";
+        src->backend_.damage = true;
+        return src;
+    }
+    const bool want_pipewire = config.backend == "pipewire" || (config.backend == "auto" && IsWaylandSession());
+    if (want_pipewire)
+    {
+#if defined(WEBRTC_USE_PIPEWIRE)
+        std::string mode;
+        src->capturer_ = CreatePipeWireCapturer(config, &mode);
+        if (src->capturer_)
+        {
+            src->backend_.backend = "pipewire";
+            src->backend_.mode = mode;
+            src->backend_.damage = true;
+        }
+#else
+        RTC_LOG(LS_WARNING) << "Built without WEBRTC_USE_PIPEWIRE (cmake -DTWEBRTC_PIPEWIRE=ON), PipeWire capture unavailable";
+#endif
+        // 明确要求 PipeWire 时不回退；auto 时回退到 X11（XWayland）
+        if (!src->capturer_ && config.backend == "pipewire")
+            return nullptr;
+    }
     if (!src->capturer_)
     {
-        RTC_LOG(LS_ERROR) << "Failed to create screen capturer";
-        return nullptr;
+        // 这里用 ScreenCapturer；如果要窗口捕获，改成 CreateWindowCapturer 并传 window id
+        webrtc::DesktopCaptureOptions options = webrtc::DesktopCaptureOptions::CreateDefault();
+        options.set_detect_updated_region(config.detect_updated_region);
+
+        // ScreenCapturerX11 不暴露实际走的读回路径，单独探测一次并记录，走 XGetImage 慢路径时告警
+        const X11CaptureProbe &probe = ProbeX11Capture();
+        src->backend_.backend = "x11";
+        src->backend_.mode = probe.PixelBufferMode();
+        src->backend_.damage = config.x11_damage && probe.xdamage;
+        src->backend_.slow_path = probe.SlowPath();
+        options.set_use_update_notifications(src->backend_.damage);
+
+        src->capturer_ = (webrtc::DesktopCapturer::CreateScreenCapturer(options));
+        if (!src->capturer_)
+        {
+            RTC_LOG(LS_ERROR) << "Failed to create screen capturer";
+            return nullptr;
+        }
     }
 
     auto list = webrtc::DesktopCapturer::SourceList{};
@@ -87,9 +206,395 @@ CapturerTrackSource::CapturerTrackSource()
 
 void CapturerTrackSource::Start()
 {
-    running_ = true;
+    if (running_.load())
+        return;
+    // 采集器永久失败后各线程在自行退出，重新启动前回收
+    JoinPipeline();
+    if (running_.exchange(true))
+        return;
+    broadcast_thread_ = std::thread([this]()
+                                    { BroadcastLoop(); });
+    convert_thread_ = std::thread([this]()
+                                  { ConvertLoop(); });
     cap_thread_ = std::thread([this]()
-                              { StartCaptureLoop(25, true); });
+                              { StartCaptureLoop(m_iTargetFps, true); });
+}
+
+void CapturerTrackSource::Stop()
+{
+    ClosePipeline();
+    JoinPipeline();
+}
+
+void CapturerTrackSource::ClosePipeline()
+{
+    running_ = false;
+    convert_queue_.Close();
+    broadcast_queue_.Close();
+}
+
+void CapturerTrackSource::JoinPipeline()
+{
+    // 先停采集，再停转换（转换完当前帧会释放 frames_held_，采集线程不会卡在 WaitForConversionSlot）
+    if (cap_thread_.joinable())
+        cap_thread_.join();
+    if (convert_thread_.joinable())
+        convert_thread_.join();
+    if (broadcast_thread_.joinable())
+        broadcast_thread_.join();
+    convert_queue_.Reset();
+    broadcast_queue_.Reset();
+    frames_held_ = 0;
+    last_timestamp_us_ = 0;
+    last_timestamp_delta_us_ = -1;
+}
+
+CapturePipelineStats CapturerTrackSource::GetPipelineStats() const
+{
+    CapturePipelineStats stats;
+    stats.captured = convert_queue_.pushed();
+    stats.convert_dropped = convert_queue_.dropped();
+    stats.converted = broadcast_queue_.pushed();
+    stats.broadcast_dropped = broadcast_queue_.dropped();
+    stats.convert_depth = convert_queue_.depth();
+    stats.broadcast_depth = broadcast_queue_.depth();
+    stats.capture_to_convert_ms = capture_to_convert_ms_.load();
+    stats.convert_ms = convert_ms_.load();
+    stats.full_chroma = full_chroma_.load();
+    stats.output_width = output_width_.load();
+    stats.output_height = output_height_.load();
+    stats.mask_rects = mask_count_.load();
+    stats.mask_ms = mask_ms_.load();
+    stats.capture_to_deliver_ms = capture_to_deliver_ms_.load();
+    stats.timestamp_jitter_ms = timestamp_jitter_ms_.load();
+    stats.grab_ms = grab_ms_.load();
+    stats.last_grab_ms = last_grab_ms_.load();
+    stats.slow_path_frames = slow_path_frames_.load();
+    return stats;
+}
+
+void CapturerTrackSource::SubmitForConversion(CapturedFrame frame)
+{
+    frames_held_.fetch_add(1);
+    // 覆盖掉的旧帧已在 Push 里释放
+    if (!convert_queue_.Push(std::move(frame)))
+        frames_held_.fetch_sub(1);
+}
+
+void CapturerTrackSource::WaitForConversionSlot()
+{
+    int held = frames_held_.load();
+    while (held >= 2 && running_)
+    {
+        frames_held_.wait(held);
+        held = frames_held_.load();
+    }
+}
+
+void CapturerTrackSource::ConvertLoop()
+{
+    // Close 之后仍会转换完已交出的帧再退出，保证 frames_held_ 归零、采集线程不会一直等
+    while (auto frame = convert_queue_.Pop())
+    {
+        // 交给转换的是采集器原始的帧（pixel_format 等以它为准），SharedDesktopFrame 只是共享引用
+        ConvertFrame(*frame->frame->GetUnderlyingFrame(), frame->capture_start_us);
+        // 释放后采集器才能复用这个缓冲
+        frame->frame.reset();
+        frames_held_.fetch_sub(1);
+        frames_held_.notify_one();
+
+        rusage ru{};
+        getrusage(RUSAGE_THREAD, &ru);
+        convert_cpu_us_.store((ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1'000'000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+    }
+}
+
+void CapturerTrackSource::BroadcastLoop()
+{
+    // 编码器（sink）慢时阻塞的是这个线程，转换线程继续用新帧覆盖旧帧
+    while (auto frame = broadcast_queue_.Pop())
+    {
+        if (!running_)
+            break;
+        const int64_t now_us = webrtc::TimeMicros();
+        const int64_t ts_us = frame->timestamp_us();
+        capture_to_deliver_ms_.store(capture_to_deliver_ms_.load() * 0.9 + (now_us - ts_us) / 1000.0 * 0.1);
+        if (last_timestamp_us_ > 0)
+        {
+            const int64_t delta_us = ts_us - last_timestamp_us_;
+            if (last_timestamp_delta_us_ >= 0)
+            {
+                const double d = std::abs(delta_us - last_timestamp_delta_us_) / 1000.0;
+                const double j = timestamp_jitter_ms_.load();
+                timestamp_jitter_ms_.store(j + (d - j) / 16.0);
+            }
+            last_timestamp_delta_us_ = delta_us;
+        }
+        last_timestamp_us_ = ts_us;
+        OnCapturedFrame(*frame);
+    }
+}
+
+void CapturerTrackSource::ConvertFrame(const webrtc::DesktopFrame &frame, int64_t capture_start_us)
+{
+    const std::optional<SourceFormat> format = SourceFormatFromFourCC(frame.pixel_format());
+    if (!format)
+    {
+        RTC_LOG_EVERY_SEC(LS_WARNING, 1) << "Unsupported captured pixel format " << frame.pixel_format()
+                                         << ", dropping frame";
+        return;
+    }
+    // 转储按 4 字节像素读取，NV12 不转储；内容检测只看 updated_region，所有格式都做
+    if (*format != SourceFormat::kNV12)
+        DumpFrame(frame, capture_start_us);
+    DetectContent(frame, capture_start_us / 1000);
+
+    // 输出尺寸对齐到配置和编码端要求的倍数，居中裁掉多余的边缘像素；裁剪在转换时一并完成
+    const int alignment = std::lcm(resolution_alignment_, std::max(1, sink_alignment_.load()));
+    const webrtc::DesktopRect crop = AlignedCrop(frame.size(), alignment);
+    const int width = crop.width();
+    const int height = crop.height();
+    if (width != output_width_.load() || height != output_height_.load())
+    {
+        output_width_.store(width);
+        output_height_.store(height);
+        RTC_LOG(LS_INFO) << "Capture output " << frame.size().width() << "x" << frame.size().height() << " -> "
+                         << width << "x" << height << " (alignment " << alignment << ")";
+    }
+    // NV12 采集帧的色度已经是 4:2:0，升到 4:4:4 只增加编码量
+    const bool full_chroma = full_chroma_.load() && *format != SourceFormat::kNV12;
+    webrtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer;
+    ConvertDest dest;
+    if (full_chroma)
+    {
+        webrtc::scoped_refptr<webrtc::I444Buffer> i444 = buffer_pool_.CreateI444Buffer(width, height);
+        if (i444)
+        {
+            dest = {i444->MutableDataY(), i444->StrideY(), i444->MutableDataU(), i444->StrideU(),
+                    i444->MutableDataV(), i444->StrideV()};
+            buffer = i444;
+        }
+    }
+    else
+    {
+        webrtc::scoped_refptr<webrtc::I420Buffer> i420 = buffer_pool_.CreateI420Buffer(width, height);
+        if (i420)
+        {
+            dest = {i420->MutableDataY(), i420->StrideY(), i420->MutableDataU(), i420->StrideU(),
+                    i420->MutableDataV(), i420->StrideV()};
+            buffer = i420;
+        }
+    }
+    if (!buffer)
+    {
+        // 缓冲都还被编码器持有，说明下游处理不过来，丢掉这一帧
+        RTC_LOG_EVERY_SEC(LS_WARNING, 1) << "Frame buffer pool exhausted, dropping captured frame";
+        return;
+    }
+
+    ConvertSource source{frame.data(), frame.stride(), nullptr, 0, frame.size().width(), frame.size().height()};
+#if defined(WEBRTC_USE_PIPEWIRE)
+    if (*format == SourceFormat::kNV12)
+    {
+        // 只有 PipeWireMappedFrame 会带 NV12（映射的 DMA-BUF/共享内存平面），没有 RTTI，按格式判断后取 UV 平面
+        const auto &mapped = static_cast<const PipeWireMappedFrame &>(frame);
+        source.uv = mapped.uv_data();
+        source.uv_stride = mapped.uv_stride();
+    }
+#endif
+    if (!source.uv && *format == SourceFormat::kNV12)
+        return;
+    source = CropSource(source, *format, crop);
+    const int64_t convert_start_us = webrtc::TimeMicros();
+    if (!GetConvertKernel(*format, full_chroma ? DestFormat::kI444 : DestFormat::kI420)(source, dest))
+        return;
+    convert_ms_.store(convert_ms_.load() * 0.9 + (webrtc::TimeMicros() - convert_start_us) / 1000.0 * 0.1);
+
+    // 隐私遮挡紧跟在转换之后，只写遮挡区域内的像素；桌面坐标换算到裁剪后的输出坐标
+    std::vector<webrtc::DesktopRect> masks;
+    if (mask_count_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mask_mutex_);
+        masks.reserve(mask_rects_.size() + window_mask_rects_.size());
+        masks.insert(masks.end(), mask_rects_.begin(), mask_rects_.end());
+        masks.insert(masks.end(), window_mask_rects_.begin(), window_mask_rects_.end());
+    }
+    if (!masks.empty())
+    {
+        const int64_t mask_start_us = webrtc::TimeMicros();
+        for (webrtc::DesktopRect &rect : masks)
+            rect.Translate(-frame.top_left().x() - crop.left(), -frame.top_left().y() - crop.top());
+        FillMaskRects(dest, full_chroma ? DestFormat::kI444 : DestFormat::kI420, width, height, masks);
+        mask_ms_.store(mask_ms_.load() * 0.9 + (webrtc::TimeMicros() - mask_start_us) / 1000.0 * 0.1);
+    }
+
+    // 时间戳取采集开始时刻而不是转换完成时刻，转换耗时的波动不会变成时间戳抖动；
+    // 采集到转换完成的耗时放在 processing_time 里随帧带给编码端
+    const int64_t converted_us = webrtc::TimeMicros();
+    capture_to_convert_ms_.store(capture_to_convert_ms_.load() * 0.9 + (converted_us - capture_start_us) / 1000.0 * 0.1);
+    webrtc::VideoFrame vf = webrtc::VideoFrame::Builder()
+                                .set_video_frame_buffer(buffer)
+                                .set_timestamp_us(capture_start_us)
+                                .set_reference_time(webrtc::Timestamp::Micros(capture_start_us))
+                                .build();
+    vf.set_processing_time({webrtc::Timestamp::Micros(capture_start_us), webrtc::Timestamp::Micros(converted_us)});
+    broadcast_queue_.Push(std::move(vf));
+}
+
+webrtc::scoped_refptr<CapturerTrackSource> CapturerTrackSource::AcquireShared(const CaptureSourceConfig &config)
+{
+    std::lock_guard<std::mutex> lock(g_shared_sources_mutex);
+    const std::string key = config.Key();
+    SharedCaptureSource &shared = g_shared_sources[key];
+    if (!shared.source)
+    {
+        shared.source = Create(config);
+        if (!shared.source)
+        {
+            g_shared_sources.erase(key);
+            return nullptr;
+        }
+    }
+    shared.users++;
+    return shared.source;
+}
+
+void CapturerTrackSource::ReleaseShared(const webrtc::scoped_refptr<CapturerTrackSource> &source)
+{
+    webrtc::scoped_refptr<CapturerTrackSource> last;
+    {
+        std::lock_guard<std::mutex> lock(g_shared_sources_mutex);
+        for (auto it = g_shared_sources.begin(); it != g_shared_sources.end(); ++it)
+        {
+            if (it->second.source != source)
+                continue;
+            if (--it->second.users == 0)
+            {
+                last = std::move(it->second.source);
+                g_shared_sources.erase(it);
+            }
+            break;
+        }
+    }
+    // 停止采集要等线程退出，不持锁
+    if (last)
+        last->Stop();
+}
+
+void CapturerTrackSource::AddContentModeCallback(const void *owner, std::function<void(ContentMode)> callback,
+                                                 ContentMode initial)
+{
+    std::lock_guard<std::mutex> lock(content_mutex_);
+    if (!motion_detector_)
+        motion_detector_ = std::make_unique<ContentMotionDetector>(ContentMotionDetector::Config{}, initial);
+    content_callbacks_.emplace_back(owner, std::move(callback));
+}
+
+void CapturerTrackSource::RemoveContentModeCallback(const void *owner)
+{
+    std::unique_lock<std::mutex> lock(content_mutex_);
+    content_callbacks_.erase(std::remove_if(content_callbacks_.begin(), content_callbacks_.end(),
+                                            [owner](const auto &cb)
+                                            { return cb.first == owner; }),
+                             content_callbacks_.end());
+    // DetectContent 在锁外回调，等已经拷出去的回调执行完
+    content_dispatch_done_.wait(lock, [this]()
+                                { return content_dispatching_ == 0; });
+}
+
+void CapturerTrackSource::EnableCaptureDump(const std::string &path, int frames)
+{
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    if (dump_writer_)
+        return;
+    dump_writer_ = std::make_unique<CaptureDumpWriter>(path, frames);
+}
+
+void CapturerTrackSource::SetFullChroma(const void *owner, bool enabled)
+{
+    std::lock_guard<std::mutex> lock(full_chroma_mutex_);
+    full_chroma_owners_[owner] = enabled;
+    UpdateFullChromaLocked();
+}
+
+void CapturerTrackSource::RemoveFullChromaOwner(const void *owner)
+{
+    std::lock_guard<std::mutex> lock(full_chroma_mutex_);
+    full_chroma_owners_.erase(owner);
+    UpdateFullChromaLocked();
+}
+
+void CapturerTrackSource::UpdateFullChromaLocked()
+{
+    const bool all = !full_chroma_owners_.empty() &&
+                     std::all_of(full_chroma_owners_.begin(), full_chroma_owners_.end(), [](const auto &o)
+                                 { return o.second; });
+    if (full_chroma_.exchange(all) != all)
+        RTC_LOG(LS_INFO) << "Capture source now converts to " << (all ? "I444" : "I420") << " ("
+                         << full_chroma_owners_.size() << " user(s))";
+}
+
+void CapturerTrackSource::SetPrivacyMask(const PrivacyMaskConfig &config)
+{
+    // 停掉旧的跟踪线程再换，它的回调会持 mask_mutex_
+    window_tracker_.reset();
+    {
+        std::lock_guard<std::mutex> lock(mask_mutex_);
+        window_mask_rects_.clear();
+    }
+    SetMaskRects(config.rects);
+    if (config.windows.empty())
+        return;
+    window_tracker_ = std::make_unique<WindowMaskTracker>(config.windows, config.poll_ms,
+                                                          [this](std::vector<webrtc::DesktopRect> rects)
+                                                          {
+                                                              std::lock_guard<std::mutex> lock(mask_mutex_);
+                                                              window_mask_rects_ = std::move(rects);
+                                                              mask_count_.store(mask_rects_.size() + window_mask_rects_.size());
+                                                          });
+    if (!window_tracker_->Start())
+        window_tracker_.reset();
+}
+
+void CapturerTrackSource::SetMaskRects(std::vector<webrtc::DesktopRect> rects)
+{
+    std::lock_guard<std::mutex> lock(mask_mutex_);
+    mask_rects_ = std::move(rects);
+    mask_count_.store(mask_rects_.size() + window_mask_rects_.size());
+}
+
+void CapturerTrackSource::DumpFrame(const webrtc::DesktopFrame &frame, int64_t capture_time_us)
+{
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    if (dump_writer_)
+        dump_writer_->Write(frame, capture_time_us);
+}
+
+void CapturerTrackSource::DetectContent(const webrtc::DesktopFrame &frame, int64_t now_ms)
+{
+    std::vector<std::function<void(ContentMode)>> callbacks;
+    std::optional<ContentMode> mode;
+    {
+        std::lock_guard<std::mutex> lock(content_mutex_);
+        if (!motion_detector_)
+            return;
+        mode = motion_detector_->OnFrame(frame, now_ms);
+        if (!mode || content_callbacks_.empty())
+            return;
+        RTC_LOG(LS_INFO) << "Content classified as " << ContentModeToString(*mode)
+                         << " (motion score " << motion_detector_->motion_score() << ")";
+        for (const auto &cb : content_callbacks_)
+            callbacks.push_back(cb.second);
+        ++content_dispatching_;
+    }
+    // 锁外回调，RemoveContentModeCallback 会等 content_dispatching_ 归零，返回后不会再回调
+    for (const auto &cb : callbacks)
+        cb(*mode);
+    {
+        std::lock_guard<std::mutex> lock(content_mutex_);
+        --content_dispatching_;
+    }
+    content_dispatch_done_.notify_all();
 }
 
 void CapturerTrackSource::StartCaptureLoop(int target_fps, bool capture_cursor)
@@ -98,37 +603,28 @@ void CapturerTrackSource::StartCaptureLoop(int target_fps, bool capture_cursor)
     {
     public:
         explicit Callback(CapturerTrackSource *src) : src_(src) {}
+        // 采集循环在 CaptureFrame 前记一次；采集器自己报告开始时刻（例如回放等到该帧时刻后）时以它为准
+        void BeginCapture() { capture_start_us_ = webrtc::TimeMicros(); }
+        void OnFrameCaptureStart() override { capture_start_us_ = webrtc::TimeMicros(); }
         void OnCaptureResult(webrtc::DesktopCapturer::Result result, std::unique_ptr<webrtc::DesktopFrame> frame) override
         {
+            if (result == webrtc::DesktopCapturer::Result::ERROR_PERMANENT)
+            {
+                // 例如不循环的回放已经播完，结束采集循环
+                RTC_LOG(LS_WARNING) << "Capturer failed permanently, stop capturing";
+                src_->ClosePipeline();
+                return;
+            }
             if (result != webrtc::DesktopCapturer::Result::SUCCESS || !frame)
                 return;
-            // 将 DesktopFrame 转为 I420 VideoFrame
-            int width = frame->size().width();
-            int height = frame->size().height();
-
-            // DesktopFrame 为 BGRA，简单起见用 libyuv 做转换（libwebrtc 已内置）
-            webrtc::scoped_refptr<webrtc::I420Buffer> i420 = webrtc::I420Buffer::Create(width, height);
-            const uint8_t *src_bgra = frame->data();
-            int src_stride_bgra = frame->stride();
-
-            // BGRA -> I420
-            libyuv::ARGBToI420(src_bgra, src_stride_bgra,
-                               i420->MutableDataY(), i420->StrideY(),
-                               i420->MutableDataU(), i420->StrideU(),
-                               i420->MutableDataV(), i420->StrideV(),
-                               width, height);
-
-            webrtc::VideoFrame vf = webrtc::VideoFrame::Builder()
-                                        .set_video_frame_buffer(i420)
-                                        .set_timestamp_us(webrtc::TimeMicros())
-                                        .build();
-
-            // src_->OnFrame(vf);
-            src_->OnCapturedFrame(vf);
+            // 采集器返回的通常已是其 ScreenCaptureFrameQueue 里缓冲的共享引用，这里只包一层，不拷贝像素；
+            // 转换（DesktopFrame BGRA -> I420）在转换线程做
+            src_->SubmitForConversion({webrtc::SharedDesktopFrame::Wrap(std::move(frame)), capture_start_us_});
         }
 
     private:
         CapturerTrackSource *src_;
+        int64_t capture_start_us_{0};
     };
 
     Callback cb(this);
@@ -137,8 +633,25 @@ void CapturerTrackSource::StartCaptureLoop(int target_fps, bool capture_cursor)
     const int interval_ms = 1000 / std::max(1, target_fps);
     while (running_)
     {
+        WaitForConversionSlot();
+        if (!running_)
+            break;
+        cb.BeginCapture();
+        const int64_t grab_start_us = webrtc::TimeMicros();
         capturer_->CaptureFrame();
-        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        // 只算采集器本身读回像素的耗时（交给转换线程很快），回放时包含等待到该帧时刻的时间
+        const double grab_ms = (webrtc::TimeMicros() - grab_start_us) / 1000.0;
+        last_grab_ms_.store(grab_ms);
+        grab_ms_.store(grab_ms_.load() * 0.9 + grab_ms * 0.1);
+        if (backend_.slow_path)
+            slow_path_frames_.fetch_add(1);
+
+        rusage ru{};
+        getrusage(RUSAGE_THREAD, &ru);
+        capture_cpu_us_.store((ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1'000'000LL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+
+        if (!self_paced_)
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
     }
 }
 
@@ -232,7 +745,22 @@ WebRTCPushClient::WebRTCPushClient(std::string id)
 
 WebRTCPushClient::~WebRTCPushClient()
 {
+    // 之后已投递但还没执行的 signaling 任务（内容模式切换）直接丢弃
+    signaling_thread_->BlockingCall([this]()
+                                    { signaling_safety_->SetNotAlive(); });
+    CpuBudgetGovernor::Instance().Unregister(this);
     StopRtpSendStatsPolling();
+    StopRecording();
+    // 先停采集（或注销共享采集源上的回调），避免内容检测回调访问正在析构的对象
+    if (video_source_)
+    {
+        video_source_->RemoveContentModeCallback(this);
+        video_source_->RemoveFullChromaOwner(this);
+        if (shared_source_)
+            CapturerTrackSource::ReleaseShared(video_source_);
+        else
+            video_source_->Stop();
+    }
     pc_ = nullptr;
     factory_ = nullptr;
     signaling_thread_->Stop();
@@ -242,17 +770,32 @@ WebRTCPushClient::~WebRTCPushClient()
 
 bool WebRTCPushClient::Init(const std::vector<IceServerConfig> &ice_servers)
 {
+    return Prepare(ice_servers) && Activate(id);
+}
+
+bool WebRTCPushClient::Prepare(const std::vector<IceServerConfig> &ice_servers)
+{
+    if (prepared_)
+        return true;
     webrtc::PeerConnectionFactoryDependencies deps;
     deps.signaling_thread = signaling_thread_.get();
     // deps.env = env_,
     deps.audio_encoder_factory = webrtc::CreateBuiltinAudioEncoderFactory();
     deps.audio_decoder_factory = webrtc::CreateBuiltinAudioDecoderFactory();
-    deps.video_encoder_factory =
-        std::make_unique<webrtc::VideoEncoderFactoryTemplate<
-            webrtc::LibvpxVp8EncoderTemplateAdapter,
-            webrtc::LibvpxVp9EncoderTemplateAdapter,
-            webrtc::OpenH264EncoderTemplateAdapter,
-            webrtc::LibaomAv1EncoderTemplateAdapter>>();
+    if (video_config_.SharesEncoder())
+    {
+        // 参数相同的观看端共用编码器；开启 keyframe_cache 时新观看端从缓存的 GOP 开始
+        const bool cache = video_config_.keyframe_cache;
+        SharedEncoderHub::Instance().SetCacheLimits(
+            cache ? static_cast<size_t>(video_config_.keyframe_cache_max_kb) * 1024 : 0,
+            cache ? video_config_.keyframe_cache_max_frames : 0,
+            static_cast<size_t>(std::max(0, video_config_.keyframe_cache_replay_max_kb)) * 1024);
+        deps.video_encoder_factory = std::make_unique<SharedVideoEncoderFactory>(CreateDesktopVideoEncoderFactory());
+    }
+    else
+    {
+        deps.video_encoder_factory = CreateDesktopVideoEncoderFactory();
+    }
     deps.video_decoder_factory =
         std::make_unique<webrtc::VideoDecoderFactoryTemplate<
             webrtc::LibvpxVp8DecoderTemplateAdapter,
@@ -286,6 +829,9 @@ bool WebRTCPushClient::Init(const std::vector<IceServerConfig> &ice_servers)
     // 4) 网络相关（根据需要开启/关闭 IPv6、网关选择等）
     config.disable_ipv6_on_wifi = false;
 
+    // 5) 创建后立即开始收集候选，SetLocalDescription 时直接使用，预热的连接不用再等 STUN
+    config.ice_candidate_pool_size = 1;
+
     observer_ = std::make_unique<PeerObserver>(&signaling, this);
 
     webrtc::PeerConnectionDependencies pc_dependencies(observer_.get());
@@ -296,54 +842,116 @@ bool WebRTCPushClient::Init(const std::vector<IceServerConfig> &ice_servers)
     {
         pc_ = std::move(error_or_peer_connection.value());
     }
+    else
+    {
+        RTC_LOG(LS_ERROR) << "CreatePeerConnection failed: " << error_or_peer_connection.error().message();
+        return false;
+    }
+
+    if (!AddDesktopVideo(video_config_))
+        return false;
+    prepared_ = true;
+    return true;
+}
 
-    AddDesktopVideo(30, 2000000);
+bool WebRTCPushClient::Activate(const std::string &viewer_id)
+{
+    if (!prepared_)
+        return false;
+    id = viewer_id;
+    join_time_ms_ = webrtc::TimeMillis();
 
-    CreateAndSendOffer();
+    // 预热时启动基准测试可能还没出结果，发 Offer 前再按最新结果排一次 codec
+    if (video_config_.EffectiveCodecPreferences().empty())
+    {
+        std::vector<std::string> codecs = CodecBenchmark::CachedPreferences();
+        if (!codecs.empty())
+            SetCodecPreferences(codecs);
+    }
+    video_source_->Start();
+    CpuBudgetGovernor::Instance().Register(this);
+    if (!video_config_.record_dir.empty())
+        StartRecording(video_config_.record_dir + "/" + id + "_" + std::to_string(webrtc::TimeMillis()) + ".ivf");
 
+    CreateAndSendOffer();
     return true;
 }
 
 bool WebRTCPushClient::AddDesktopVideo(int fps, int max_bitrate_bps)
 {
-    auto source = CapturerTrackSource::Create(fps);
+    VideoSendConfig config;
+    config.fps = fps;
+    config.max_bitrate_bps = max_bitrate_bps;
+    return AddDesktopVideo(config);
+}
+
+bool WebRTCPushClient::AddDesktopVideo(const VideoSendConfig &config)
+{
+    video_config_ = config;
+    // 共享编码器时所有观看端共用一个采集源，采集和格式转换只做一次
+    shared_source_ = config.SharesEncoder();
+    auto source = shared_source_ ? CapturerTrackSource::AcquireShared(config.CaptureSource())
+                                 : CapturerTrackSource::Create(config.CaptureSource());
     if (!source)
     {
-        printf("Failed to create DesktopCapturerSource\n");
+        RTC_LOG(LS_ERROR) << "Failed to create DesktopCapturerSource";
         return false;
     }
 
+    if (!config.capture_dump_path.empty())
+        source->EnableCaptureDump(config.capture_dump_path, config.capture_dump_frames);
+
     video_track_ = factory_->CreateVideoTrack(source, "desktop");
     if (!video_track_)
     {
-        printf("Failed to create VideoTrack\n");
+        RTC_LOG(LS_ERROR) << "Failed to create VideoTrack";
         return false;
     }
 
     webrtc::RtpTransceiverInit init;
     init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
+    // 码率/帧率/分层在创建时就写进 send_encodings，simulcast 的 rid 只能在这里指定
+    init.send_encodings = config.ToSendEncodings();
+    video_track_->set_content_hint(ToTrackContentHint(config.content_mode));
+
     auto transceiver_or = pc_->AddTransceiver(video_track_, init);
     if (!transceiver_or.ok())
     {
         RTC_LOG(LS_ERROR) << "AddTransceiver failed: " << transceiver_or.error().message();
-        printf("AddTransceiver failed\n");
         return false;
     }
-    auto transceiver = transceiver_or.value();
-    video_sender_ = transceiver->sender();
-
-    // 设置码率上限
-    if (max_bitrate_bps > 0)
+    video_transceiver_ = transceiver_or.value();
+    video_sender_ = video_transceiver_->sender();
+    if (!config.record_dir.empty())
     {
-        webrtc::RtpParameters params = video_sender_->GetParameters();
-        if (!params.encodings.empty())
-        {
-            params.encodings[0].max_bitrate_bps = max_bitrate_bps;
-            video_sender_->SetParameters(params);
-        }
+        // 协商前挂上，之后开始/停止录制不需要重建发送流
+        recorder_ = webrtc::make_ref_counted<EncodedFrameRecorder>(config.record_rid);
+        video_sender_->SetFrameTransformer(recorder_);
     }
-
-    source->Start();
+    SetContentMode(config.content_mode);
+
+    max_bitrate_bps_ = config.max_bitrate_bps;
+    if (config.adaptive_bitrate)
+        abr_ = std::make_unique<AdaptiveBitrateController>(config.bitrate_policy, config.max_bitrate_bps, config.fps);
+
+    // SVC 需要协商到 VP9/AV1 才生效，必须在 CreateOffer 之前设置；
+    // 没有显式配置时使用启动基准测试选出的编码器顺序
+    std::vector<std::string> codecs = config.EffectiveCodecPreferences();
+    if (codecs.empty())
+        codecs = CodecBenchmark::CachedPreferences();
+    if (!codecs.empty() || config.full_chroma)
+        SetCodecPreferences(codecs);
+    RTC_LOG(LS_INFO) << "Video sender created with " << init.send_encodings.size() << " encoding(s)";
+
+    if (config.auto_content_mode)
+    {
+        source->AddContentModeCallback(this, [this](ContentMode mode)
+                                       { OnContentClassified(mode); },
+                                       config.content_mode);
+    }
+    // 还没协商完的使用者按 4:2:0 计，共享采集源上不会先为别人转出 I444
+    source->SetFullChroma(this, false);
+    video_source_ = source;
     return true;
 }
 
@@ -366,8 +974,9 @@ bool WebRTCPushClient::CreateAndSendOffer(bool ice_restart)
                 desc->ToString(&sdp);
                 if (signaling.onLocalSdp)
                     signaling.onLocalSdp({"offer", sdp}, id);
-                RTC_LOG(LS_INFO) << "Local Offer:\n"
-                                 << sdp;
+                RTC_LOG(LS_INFO) << "Local Offer created, sdp size=" << sdp.size();
+                RTC_LOG(LS_VERBOSE) << "Local Offer:\n"
+                                    << sdp;
             },
             [](webrtc::RTCError err)
             {
@@ -379,8 +988,8 @@ bool WebRTCPushClient::CreateAndSendOffer(bool ice_restart)
 
 bool WebRTCPushClient::SetRemoteAnswer(const std::string &sdp_answer)
 {
-    printf("%s\n", sdp_answer.c_str());
-    return false;
+    RTC_LOG(LS_VERBOSE) << "Remote Answer:\n"
+                        << sdp_answer;
     auto desc = webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, sdp_answer);
     if (!desc)
     {
@@ -409,14 +1018,307 @@ bool WebRTCPushClient::AddRemoteIce(const std::string &candidate_sdp, int sdp_ml
 }
 
 bool WebRTCPushClient::SetMaxBitrate(int bps)
+{
+    if (!video_sender_)
+        return false;
+    // 编码限制相关状态只在 signaling 线程修改（统计回调也在该线程）
+    return signaling_thread_->BlockingCall([this, bps]()
+                                           {
+        max_bitrate_bps_ = bps;
+        // 码率控制器以新的上限为准重新开始
+        if (abr_)
+            abr_ = std::make_unique<AdaptiveBitrateController>(abr_->policy(), bps, video_config_.fps);
+        return ApplyEncodingLimits(); });
+}
+
+bool WebRTCPushClient::ApplyEncodingLimits()
 {
     if (!video_sender_)
         return false;
     auto params = video_sender_->GetParameters();
     if (params.encodings.empty())
         params.encodings.push_back(webrtc::RtpEncodingParameters());
-    params.encodings[0].max_bitrate_bps = bps;
-    return video_sender_->SetParameters(params).ok();
+
+    // 共享编码器时分辨率/帧率是编码器 key 的一部分，单个观看端的 ABR/CPU 调整会把它拆到独立的编码器上，
+    // ABR 的码率上限也会经最低码率拖累同一层的所有观看端，因此只按配置和内容模式（同一采集源的观看端一致）设置
+    const bool shared = video_config_.SharesEncoder();
+    int total_bps = max_bitrate_bps_;
+    int fps_cap = 0;
+    double extra_scale = 1.0;
+    if (abr_ && !shared)
+    {
+        total_bps = std::min(total_bps, abr_->current().max_bitrate_bps);
+        fps_cap = abr_->current().max_framerate;
+        extra_scale = abr_->current().scale_down_by;
+    }
+    // CPU 降级：奇数级帧率 x0.75，偶数级分辨率 /1.3
+    const int cpu_level = shared ? 0 : cpu_degradation_level_.load();
+    const double cpu_fps_factor = std::pow(0.75, (cpu_level + 1) / 2);
+    extra_scale *= std::pow(1.3, cpu_level / 2);
+
+    // simulcast：按配置中各层码率的比例分配总码率
+    const auto &layers = video_config_.simulcast_layers;
+    const bool simulcast = video_config_.IsSimulcast() && params.encodings.size() > 1;
+    int64_t configured_total = 0;
+    for (const auto &layer : layers)
+        configured_total += std::max(0, layer.max_bitrate_bps);
+
+    const ContentMode mode = video_config_.content_mode;
+    for (size_t i = 0; i < params.encodings.size(); ++i)
+    {
+        const bool has_layer = simulcast && i < layers.size();
+        int fps = has_layer && layers[i].max_framerate > 0 ? layers[i].max_framerate : video_config_.fps;
+        double scale = has_layer ? std::max(1.0, layers[i].scale_resolution_down_by) : 1.0;
+        int bps = total_bps;
+        if (simulcast)
+        {
+            const int layer_bps = has_layer ? layers[i].max_bitrate_bps : 0;
+            if (configured_total > 0 && layer_bps > 0)
+                bps = static_cast<int>(int64_t{total_bps} * layer_bps / configured_total);
+            else
+                bps = total_bps / static_cast<int>(params.encodings.size());
+        }
+
+        // 自动内容模式：text 限帧率保清晰，fluid 降分辨率保流畅
+        if (video_config_.auto_content_mode)
+        {
+            if (mode == ContentMode::kFluid)
+                scale *= std::max(1.0, video_config_.fluid_scale_down_by);
+            else
+                fps = std::min(fps, std::max(1, video_config_.text_max_fps));
+        }
+        if (fps_cap > 0)
+            fps = std::min(fps, fps_cap);
+        fps = std::max(1, static_cast<int>(fps * cpu_fps_factor));
+        scale *= extra_scale;
+
+        auto &enc = params.encodings[i];
+        enc.max_bitrate_bps = bps;
+        enc.max_framerate = fps;
+        enc.scale_resolution_down_by = scale;
+    }
+
+    auto err = video_sender_->SetParameters(params);
+    if (!err.ok())
+    {
+        RTC_LOG(LS_ERROR) << "Apply encoding limits failed: " << err.message();
+        return false;
+    }
+    return true;
+}
+
+bool WebRTCPushClient::StartRecording(const std::string &path)
+{
+    if (!video_sender_)
+        return false;
+    if (!recorder_)
+    {
+        recorder_ = webrtc::make_ref_counted<EncodedFrameRecorder>(video_config_.record_rid);
+        video_sender_->SetFrameTransformer(recorder_);
+    }
+    return recorder_->Start(path);
+}
+
+void WebRTCPushClient::StopRecording()
+{
+    if (recorder_)
+        recorder_->Stop();
+}
+
+void WebRTCPushClient::OnFramesEncoded()
+{
+    if (join_time_ms_ == 0 || first_frame_latency_ms_.load() >= 0)
+        return;
+    const int64_t latency_ms = webrtc::TimeMillis() - join_time_ms_;
+    first_frame_latency_ms_.store(latency_ms);
+    RTC_LOG(LS_INFO) << "[JOIN] " << id << " join-to-first-frame " << latency_ms << " ms";
+    if (video_config_.SharesEncoder())
+    {
+        const SharedEncoderHub::Stats s = SharedEncoderHub::Instance().GetStats();
+        RTC_LOG(LS_INFO) << "[JOIN] gop cache hits=" << s.cache_hits << " misses=" << s.cache_misses
+                         << " replayed=" << s.frames_replayed << ", encoders=" << s.encoders
+                         << " subscribers=" << s.subscribers;
+    }
+}
+
+void WebRTCPushClient::SetCpuDegradationLevel(int level)
+{
+    level = std::clamp(level, 0, CpuBudgetGovernor::kMaxDegradationLevel);
+    if (cpu_degradation_level_.exchange(level) == level || !video_sender_)
+        return;
+    signaling_thread_->BlockingCall([this]()
+                                    { ApplyEncodingLimits(); });
+}
+
+void WebRTCPushClient::OnNetworkSample(const NetworkSample &sample)
+{
+    if (!abr_)
+        return;
+    std::string reason;
+    auto limits = abr_->OnSample(sample, video_config_.content_mode, &reason);
+    if (!limits)
+        return;
+    RTC_LOG(LS_INFO) << "[ABR] " << id << " policy=" << abr_->policy().name
+                     << " rtt=" << sample.rtt_ms << "ms loss=" << sample.loss_fraction
+                     << " available=" << sample.available_outgoing_bps
+                     << " -> max_bitrate=" << limits->max_bitrate_bps
+                     << " max_fps=" << limits->max_framerate
+                     << " scale_down=" << limits->scale_down_by
+                     << " (" << reason << ")";
+    ApplyEncodingLimits();
+}
+
+bool WebRTCPushClient::SetScalabilityMode(const std::string &mode)
+{
+    if (!video_sender_)
+        return false;
+    if (!mode.empty() && !webrtc::ScalabilityModeStringToNumTemporalLayers(mode))
+    {
+        RTC_LOG(LS_ERROR) << "Unknown scalability mode: " << mode;
+        return false;
+    }
+    auto params = video_sender_->GetParameters();
+    for (auto &enc : params.encodings)
+    {
+        if (mode.empty())
+            enc.scalability_mode.reset();
+        else
+            enc.scalability_mode = mode;
+    }
+    auto err = video_sender_->SetParameters(params);
+    if (!err.ok())
+    {
+        RTC_LOG(LS_ERROR) << "SetScalabilityMode(" << mode << ") failed: " << err.message();
+        return false;
+    }
+    video_config_.scalability_mode = mode;
+    return true;
+}
+
+bool WebRTCPushClient::SetCodecPreferences(const std::vector<std::string> &codec_names)
+{
+    if (!video_transceiver_ || !factory_ || (codec_names.empty() && !video_config_.full_chroma))
+        return false;
+
+    std::vector<webrtc::RtpCodecCapability> all =
+        factory_->GetRtpSenderCapabilities(webrtc::MediaType::VIDEO).codecs;
+    std::vector<webrtc::RtpCodecCapability> ordered;
+    std::vector<bool> taken(all.size(), false);
+    // 4:4:4 格式排在最前面：对端不能解码时 Answer 里没有它，自然落到后面的 4:2:0 格式。
+    // 发送能力来自编码器工厂，libwebrtc 的编码器不支持 profile 1 时这里一个都没有
+    if (video_config_.full_chroma)
+    {
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            if (IsFullChromaCodec(all[i]))
+            {
+                ordered.push_back(all[i]);
+                taken[i] = true;
+            }
+        }
+        if (ordered.empty())
+            RTC_LOG(LS_WARNING) << "full_chroma: no VP9/AV1 profile 1 encoder available, staying on 4:2:0";
+    }
+    for (const auto &name : codec_names)
+    {
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            if (!taken[i] && absl::EqualsIgnoreCase(all[i].name, name))
+            {
+                ordered.push_back(all[i]);
+                taken[i] = true;
+            }
+        }
+    }
+    if (ordered.empty())
+    {
+        RTC_LOG(LS_WARNING) << "None of the preferred codecs is available, keep default order";
+        return false;
+    }
+    // 其余 codec（包括 rtx/red/ulpfec）保持原顺序，作为对端不支持首选 codec 时的回退
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        if (!taken[i])
+            ordered.push_back(all[i]);
+    }
+
+    auto err = video_transceiver_->SetCodecPreferences(ordered);
+    if (!err.ok())
+    {
+        RTC_LOG(LS_ERROR) << "SetCodecPreferences failed: " << err.message();
+        return false;
+    }
+    RTC_LOG(LS_INFO) << "Codec preference: " << ordered.front().name;
+    video_config_.codec_preferences = codec_names;
+    return true;
+}
+
+void WebRTCPushClient::OnNegotiationComplete()
+{
+    if (!video_config_.full_chroma || !video_sender_ || !video_source_)
+        return;
+    // 发送用的 codec：显式指定的 encodings[0].codec，否则是协商结果里的第一个
+    const webrtc::RtpParameters params = video_sender_->GetParameters();
+    bool full_chroma = false;
+    if (!params.encodings.empty() && params.encodings[0].codec)
+        full_chroma = IsFullChromaCodec(*params.encodings[0].codec);
+    else if (!params.codecs.empty())
+        full_chroma = IsFullChromaCodec(params.codecs.front());
+    video_source_->SetFullChroma(this, full_chroma);
+    RTC_LOG(LS_INFO) << "Negotiated " << (full_chroma ? "4:4:4" : "4:2:0") << " video for " << id;
+}
+
+bool WebRTCPushClient::SetContentMode(ContentMode mode)
+{
+    if (!video_track_ || !video_sender_)
+        return false;
+    // video_config_.content_mode 由 ApplyEncodingLimits / OnNetworkSample 在 signaling 线程读取，
+    // 和编码参数一起只在 signaling 线程修改（已在 signaling 线程时直接执行）
+    return signaling_thread_->BlockingCall([this, mode]()
+                                           {
+        const VideoSendMetrics before = GetVideoSendMetrics();
+        video_track_->set_content_hint(ToTrackContentHint(mode));
+
+        auto params = video_sender_->GetParameters();
+        params.degradation_preference = ToDegradationPreference(mode);
+        auto err = video_sender_->SetParameters(params);
+        if (!err.ok())
+        {
+            RTC_LOG(LS_ERROR) << "SetContentMode(" << ContentModeToString(mode) << ") failed: " << err.message();
+            return false;
+        }
+
+        // 记录切换前的编码指标，之后的 [ENCODE-STATS] 日志即为切换后的效果
+        RTC_LOG(LS_INFO) << "Content mode " << ContentModeToString(video_config_.content_mode)
+                         << " -> " << ContentModeToString(mode)
+                         << ", before: encode_ms=" << before.avg_encode_ms
+                         << " fps=" << before.encode_fps
+                         << " res=" << before.frame_width << "x" << before.frame_height
+                         << " qp=" << before.avg_qp;
+        video_config_.content_mode = mode;
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics_.content_mode = mode;
+        return true; });
+}
+
+void WebRTCPushClient::OnContentClassified(ContentMode mode)
+{
+    // 在转换线程被调用，投递到 signaling 线程统一修改编码参数，不等待：
+    // 共享采集源上每个观看端都同步等一次 signaling 线程，会让转换线程在运动开始时丢帧
+    signaling_thread_->PostTask(webrtc::SafeTask(signaling_safety_, [this, mode]()
+                                                 {
+        if (!SetContentMode(mode) || !ApplyEncodingLimits())
+            return;
+        auto params = video_sender_->GetParameters();
+        RTC_LOG(LS_INFO) << "Content tuning " << ContentModeToString(mode)
+                         << ": max_fps=" << params.encodings[0].max_framerate.value_or(0)
+                         << " scale_down=" << params.encodings[0].scale_resolution_down_by.value_or(1.0); }));
+}
+
+VideoSendMetrics WebRTCPushClient::GetVideoSendMetrics() const
+{
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    return metrics_;
 }
 
 void WebRTCPushClient::StartRtpSendStatsPolling(int interval_ms)
@@ -436,7 +1338,9 @@ void WebRTCPushClient::StartRtpSendStatsPolling(int interval_ms)
         while (stats_polling_.load())
         {
             PollRtpSendStatsOnce();
-            std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+            // 首帧之前加快轮询，加入到首帧的耗时更准确
+            const int next_ms = first_frame_latency_ms_.load() < 0 ? 100 : sleep_ms;
+            std::this_thread::sleep_for(std::chrono::milliseconds(next_ms));
         } });
 }
 
@@ -475,6 +1379,33 @@ void WebRTCPushClient::PollRtpSendStatsOnce()
             uint64_t best_packets_sent = 0;
             bool found_video_outbound = false;
 
+            // 网络状况：当前选中的 candidate pair + 对端 RTCP 反馈
+            NetworkSample net;
+            for (const webrtc::RTCIceCandidatePairStats *pair : report->GetStatsOfType<webrtc::RTCIceCandidatePairStats>())
+            {
+                if (!pair || !pair->nominated.value_or(false) || pair->state.value_or("") != "succeeded")
+                    continue;
+                net.rtt_ms = pair->current_round_trip_time.value_or(0) * 1000.0;
+                net.available_outgoing_bps = static_cast<int>(pair->available_outgoing_bitrate.value_or(0));
+            }
+            for (const webrtc::RTCRemoteInboundRtpStreamStats *r : report->GetStatsOfType<webrtc::RTCRemoteInboundRtpStreamStats>())
+            {
+                if (!r || !r->kind || *r->kind != "video")
+                    continue;
+                net.loss_fraction = std::max(net.loss_fraction, r->fraction_lost.value_or(0));
+                if (r->round_trip_time)
+                    net.rtt_ms = std::max(net.rtt_ms, *r->round_trip_time * 1000.0);
+            }
+            owner_->OnNetworkSample(net);
+
+            // 编码指标在所有层（simulcast）上累加
+            uint32_t frames_encoded = 0;
+            double total_encode_time_s = 0;
+            uint64_t qp_sum = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            std::string limitation;
+
             // 强类型遍历 outbound-rtp
             for (const webrtc::RTCOutboundRtpStreamStats *s : report->GetStatsOfType<webrtc::RTCOutboundRtpStreamStats>())
             {
@@ -484,6 +1415,15 @@ void WebRTCPushClient::PollRtpSendStatsOnce()
                     continue;
 
                 found_video_outbound = true;
+                frames_encoded += s->frames_encoded.value_or(0);
+                total_encode_time_s += s->total_encode_time.value_or(0);
+                qp_sum += s->qp_sum.value_or(0);
+                if (s->frame_width.value_or(0) >= width)
+                {
+                    width = s->frame_width.value_or(0);
+                    height = s->frame_height.value_or(0);
+                    limitation = s->quality_limitation_reason.value_or("");
+                }
                 if (*s->bytes_sent >= best_bytes_sent)
                 {
                     best_bytes_sent = *s->bytes_sent;
@@ -495,9 +1435,11 @@ void WebRTCPushClient::PollRtpSendStatsOnce()
             if (!found_video_outbound)
             {
                 owner_->is_sending_rtp_video_.store(false);
-                RTC_LOG(LS_INFO) << "[RTP-STATS] outbound-rtp(video) not found";
+                RTC_LOG_EVERY_SEC(LS_INFO, 1) << "[RTP-STATS] outbound-rtp(video) not found";
                 return;
             }
+            if (frames_encoded > 0)
+                owner_->OnFramesEncoded();
 
             uint64_t last_bytes = owner_->last_video_bytes_sent_.exchange(best_bytes_sent);
             uint64_t last_packets = owner_->last_video_packets_sent_.exchange(best_packets_sent);
@@ -505,11 +1447,13 @@ void WebRTCPushClient::PollRtpSendStatsOnce()
             const bool sending = (best_bytes_sent > last_bytes);
             owner_->is_sending_rtp_video_.store(sending);
 
-            RTC_LOG(LS_INFO) << "[RTP-STATS] video outbound bytesSent=" << best_bytes_sent
-                             << " (delta=" << (best_bytes_sent - last_bytes) << ")"
-                             << " packetsSent=" << best_packets_sent
-                             << " (delta=" << (best_packets_sent - last_packets) << ")"
-                             << " sending=" << (sending ? "YES" : "NO");
+            RTC_LOG(LS_VERBOSE) << "[RTP-STATS] video outbound bytesSent=" << best_bytes_sent
+                                << " (delta=" << (best_bytes_sent - last_bytes) << ")"
+                                << " packetsSent=" << best_packets_sent
+                                << " (delta=" << (best_packets_sent - last_packets) << ")"
+                                << " sending=" << (sending ? "YES" : "NO");
+
+            UpdateEncodeMetrics(frames_encoded, total_encode_time_s, qp_sum, width, height, limitation);
         }
 
         void AddRef() const override {}
@@ -520,17 +1464,78 @@ void WebRTCPushClient::PollRtpSendStatsOnce()
         }
 
     private:
+        void UpdateEncodeMetrics(uint32_t frames_encoded, double total_encode_time_s, uint64_t qp_sum,
+                                 uint32_t width, uint32_t height, const std::string &limitation)
+        {
+            const int64_t now_ms = webrtc::TimeMillis();
+            std::lock_guard<std::mutex> lock(owner_->metrics_mutex_);
+            const uint32_t frames = frames_encoded - owner_->last_frames_encoded_;
+            const int64_t elapsed_ms = now_ms - owner_->last_stats_time_ms_;
+            VideoSendMetrics &m = owner_->metrics_;
+            if (owner_->last_stats_time_ms_ > 0 && frames_encoded >= owner_->last_frames_encoded_)
+            {
+                m.avg_encode_ms = frames > 0 ? (total_encode_time_s - owner_->last_total_encode_time_s_) * 1000.0 / frames : 0;
+                m.avg_qp = frames > 0 ? static_cast<double>(qp_sum - owner_->last_qp_sum_) / frames : 0;
+                m.encode_fps = elapsed_ms > 0 ? frames * 1000.0 / elapsed_ms : 0;
+            }
+            m.frame_width = width;
+            m.frame_height = height;
+            m.quality_limitation_reason = limitation;
+            owner_->last_frames_encoded_ = frames_encoded;
+            owner_->last_total_encode_time_s_ = total_encode_time_s;
+            owner_->last_qp_sum_ = qp_sum;
+            owner_->last_stats_time_ms_ = now_ms;
+
+            RTC_LOG(LS_VERBOSE) << "[ENCODE-STATS] mode=" << ContentModeToString(m.content_mode)
+                                << " encode_ms=" << m.avg_encode_ms
+                                << " fps=" << m.encode_fps
+                                << " res=" << m.frame_width << "x" << m.frame_height
+                                << " qp=" << m.avg_qp
+                                << " limitation=" << m.quality_limitation_reason;
+
+            const CapturePipelineStats p = owner_->GetCapturePipelineStats();
+            RTC_LOG(LS_VERBOSE) << "[PIPELINE] captured=" << p.captured << " convert_dropped=" << p.convert_dropped
+                                << " converted=" << p.converted << " broadcast_dropped=" << p.broadcast_dropped
+                                << " depth=" << p.convert_depth << "/" << p.broadcast_depth
+                                << " capture_to_convert_ms=" << p.capture_to_convert_ms
+                                << " convert_ms=" << p.convert_ms
+                                << " capture_to_deliver_ms=" << p.capture_to_deliver_ms
+                                << " ts_jitter_ms=" << p.timestamp_jitter_ms
+                                << " grab_ms=" << p.grab_ms << " (last " << p.last_grab_ms << ")"
+                                << " chroma=" << (p.full_chroma ? "444" : "420")
+                                << " output=" << p.output_width << "x" << p.output_height
+                                << " masks=" << p.mask_rects << " mask_ms=" << p.mask_ms
+                                << " slow_path_frames=" << p.slow_path_frames;
+            if (!owner_->slow_path_warned_ && owner_->video_source_ &&
+                owner_->video_source_->backend_info().slow_path)
+            {
+                owner_->slow_path_warned_ = true;
+                const CaptureBackendInfo &b = owner_->video_source_->backend_info();
+                RTC_LOG(LS_WARNING) << "[CAPTURE] " << b.backend << " capture on slow path (" << b.mode
+                                    << "), grab_ms=" << p.grab_ms << " slow_path_frames=" << p.slow_path_frames;
+            }
+        }
+
         WebRTCPushClient *owner_;
     };
 
     pc_->GetStats(new StatsCallback(this));
 }
 
+void PeerObserver::OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state)
+{
+    RTC_LOG(LS_INFO) << "Signaling state: " << new_state;
+    if (owner_ && new_state == webrtc::PeerConnectionInterface::SignalingState::kStable)
+        owner_->OnNegotiationComplete();
+}
+
 void PeerObserver::OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state)
 {
     RTC_LOG(LS_INFO) << "PeerConnection state: " << new_state;
     if (!owner_)
         return;
+    if (signaling_ && signaling_->onConnectionState)
+        signaling_->onConnectionState(owner_->getId(), new_state);
     if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kConnected)
     {
         owner_->StartRtpSendStatsPolling(1000);
@@ -5,6 +5,10 @@
 #include <atomic>
 #include <thread>
 #include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <set>
 
 #include "api/peer_connection_interface.h"
 #include "api/create_peerconnection_factory.h"
@@ -14,10 +18,12 @@
 #include "api/media_stream_interface.h"
 #include "api/rtp_sender_interface.h"
 #include "api/rtp_parameters.h"
+#include "api/video_codecs/video_encoder_factory.h"
 #include "pc/session_description.h"
 #include "pc/video_track_source.h"
 #include "rtc_base/ref_counted_object.h"
 #include "rtc_base/thread.h"
+#include "api/task_queue/pending_task_safety_flag.h"
 #include "rtc_base/ssl_adapter.h"
 #include "rtc_base/logging.h"
 #include "media/base/adapted_video_track_source.h"
@@ -25,10 +31,23 @@
 #include "modules/desktop_capture/desktop_capture_options.h"
 #include "modules/desktop_capture/desktop_frame.h"
 #include "modules/desktop_capture/screen_capturer_helper.h"
+#include "modules/desktop_capture/shared_desktop_frame.h"
+#include "common_video/include/video_frame_buffer_pool.h"
 #include "absl/types/optional.h"
 #include "media/base/video_broadcaster.h"
 // getStats
 #include "api/stats/rtc_stats_report.h"
+#include "video_send_config.h"
+#include "content_motion_detector.h"
+#include "bitrate_controller.h"
+#include "encoded_frame_recorder.h"
+#include "capture_dump.h"
+#include "latest_frame_queue.h"
+#include "replay_capturer.h"
+#include "x11_capture_probe.h"
+#include "pipewire_capturer.h"
+#include "frame_converter.h"
+#include "window_mask_tracker.h"
 // 如果需要窗口捕获：#include "modules/desktop_capture/window_capturer.h"
 // 如果需要窗口捕获：#include "modules/desktop_capture/window_capturer.h"
 
@@ -39,18 +58,70 @@ struct IceServerConfig
     std::string password; // TURN 密码
 };
 
+// 最近一个统计周期内的编码指标，用来对比不同内容模式/编码配置的效果
+struct VideoSendMetrics
+{
+    ContentMode content_mode{ContentMode::kDetailed};
+    double avg_encode_ms{0}; // 周期内每帧平均编码耗时
+    double encode_fps{0};    // 周期内实际编码帧率（多层时取所有层之和）
+    uint32_t frame_width{0}; // 最高层的编码分辨率
+    uint32_t frame_height{0};
+    double avg_qp{0};
+    std::string quality_limitation_reason; // "none" / "cpu" / "bandwidth" / "other"
+};
+
+// 采集 -> 转换 -> 分发流水线的计数，丢帧都是新帧覆盖了下一阶段还没取走的旧帧
+struct CapturePipelineStats
+{
+    uint64_t captured{0};          // 交给转换阶段的帧数
+    uint64_t convert_dropped{0};   // 转换来不及、被新采集帧覆盖的帧数
+    uint64_t converted{0};         // 交给分发阶段的帧数
+    uint64_t broadcast_dropped{0}; // 编码端（sink）来不及、被新转换帧覆盖的帧数
+    int convert_depth{0};          // 当前等待转换的帧数（0 或 1）
+    int broadcast_depth{0};        // 当前等待分发的帧数（0 或 1）
+    // 以下为平滑值（毫秒），时间起点都是采集开始时刻（也是 VideoFrame 的时间戳）
+    double capture_to_convert_ms{0}; // 采集开始到转换完成
+    double convert_ms{0};            // 其中像素格式转换本身的耗时
+    double capture_to_deliver_ms{0}; // 采集开始到交给编码端（sink）
+    double timestamp_jitter_ms{0};   // 相邻帧时间戳间隔的抖动（RFC 3550 方式平滑的 |D(i) - D(i-1)|）
+    double grab_ms{0};               // 采集器每帧读回耗时（平滑值）
+    double last_grab_ms{0};
+    uint64_t slow_path_frames{0};    // 在慢路径（例如 X11 XGetImage 全量读回）上采集的帧数
+    bool full_chroma{false};         // 当前转换输出 I444
+    int mask_rects{0};               // 当前生效的隐私遮挡区域数
+    double mask_ms{0};               // 转换后涂黑遮挡区域的耗时（平滑值）
+    int output_width{0};             // 对齐裁剪后交给编码端的尺寸
+    int output_height{0};
+};
+
+// 采集源实际使用的后端，创建时确定
+struct CaptureBackendInfo
+{
+    std::string backend{"none"}; // "x11" / "pipewire" / "replay"
+    std::string mode;            // x11: "shm-pixmap" / "shm-getimage" / "xgetimage"；pipewire: "portal" / "node"；replay: "realtime" / "fast"
+    bool damage{false};          // 是否只读回变化区域（X11 XDamage）
+    bool slow_path{false};       // 每帧全量读回，CPU 开销高
+};
+
 struct SdpBundle
 {
     std::string type; // "offer" 或 "answer"
     std::string sdp;
 };
 
+// 推流使用的编码器工厂（VP8/VP9/H264/AV1），编码器基准测试也用它
+std::unique_ptr<webrtc::VideoEncoderFactory> CreateDesktopVideoEncoderFactory();
+// VP9 profile 1 / AV1 profile 1（8 bit 4:4:4）
+bool IsFullChromaCodec(const webrtc::RtpCodec &codec);
+
 class SimpleSignaling
 {
 public:
     // 你可以把这三个回调接到你的 WebSocket/HTTP 信令
     std::function<void(const SdpBundle &, std::string id)> onLocalSdp;
     std::function<void(const std::string &)> onLocalIce;
+    // PeerConnection 状态变化（signaling 线程回调），用于准入控制统计协商中/已断开的观看端
+    std::function<void(const std::string &id, webrtc::PeerConnectionInterface::PeerConnectionState)> onConnectionState;
 };
 
 class DesktopCapturerSource : public webrtc::AdaptedVideoTrackSource,
@@ -92,13 +163,14 @@ private:
 class CapturerTrackSource : public webrtc::VideoTrackSource
 {
 public:
-    static webrtc::scoped_refptr<CapturerTrackSource> Create(int target_fps = 30, bool capture_cursor = true);
+    // config.replay.path 非空时回放采集转储文件而不是采集屏幕
+    static webrtc::scoped_refptr<CapturerTrackSource> Create(const CaptureSourceConfig &config = {});
 
     ~CapturerTrackSource() override
     {
-        running_ = false;
-        if (cap_thread_.joinable())
-            cap_thread_.join();
+        // 先停窗口跟踪，它的回调会写遮挡区域
+        window_tracker_.reset();
+        Stop();
     }
 
 public:
@@ -111,6 +183,38 @@ public:
 
 
     void Start();
+    // 停止采集、转换、分发线程并等待其退出，之后不会再有回调
+    void Stop();
+    CapturePipelineStats GetPipelineStats() const;
+    const CaptureBackendInfo &backend_info() const { return backend_; }
+
+    // 多个推流客户端共用的采集源（共享编码器时使用），参数相同时返回同一个实例。
+    // 每次 AcquireShared 对应一次 ReleaseShared，最后一个使用者释放时停止采集
+    static webrtc::scoped_refptr<CapturerTrackSource> AcquireShared(const CaptureSourceConfig &config);
+    static void ReleaseShared(const webrtc::scoped_refptr<CapturerTrackSource> &source);
+
+    // 开启内容运动检测，分类变化时在转换线程回调所有注册者（不持锁，回调应只投递任务、尽快返回）；owner 用于注销
+    void AddContentModeCallback(const void *owner, std::function<void(ContentMode)> callback, ContentMode initial);
+    // 返回后不会再回调该 owner（会等正在进行的回调结束）
+    void RemoveContentModeCallback(const void *owner);
+
+    // 采集线程和转换线程累计 CPU 时间（getrusage RUSAGE_THREAD），不含分发（编码端的开销另算）
+    int64_t CaptureCpuMicros() const { return capture_cpu_us_.load() + convert_cpu_us_.load(); }
+
+    // 把采集到的原始帧写入环形转储文件，保留最近 frames 帧；共享采集源只有第一次调用生效
+    void EnableCaptureDump(const std::string &path, int frames);
+
+    // 每个使用者登记自己是否协商到 4:4:4，所有使用者都是 4:4:4 时转换输出 I444（NV12 采集帧除外）。
+    // 共享采集源上只要有一个 4:2:0 的编码器就输出 I420，避免每个编码器各自再做一次 I444 -> I420
+    void SetFullChroma(const void *owner, bool enabled);
+    void RemoveFullChromaOwner(const void *owner);
+
+    // 隐私遮挡：config.rects（桌面坐标）在转换输出里涂黑；config.windows 非空时（X11）后台跟踪匹配窗口的位置，
+    // 一起遮挡。再次调用替换之前的设置
+    void SetPrivacyMask(const PrivacyMaskConfig &config);
+    // 只替换固定遮挡区域，窗口跟踪不变
+    void SetMaskRects(std::vector<webrtc::DesktopRect> rects);
+
 protected:
     // VideoTrackSource 接口
     webrtc::MediaSourceInterface::SourceState state() const override
@@ -118,27 +222,106 @@ protected:
         return webrtc::MediaSourceInterface::SourceState::kLive;
     }
     bool remote() const override { return false; }
+    // 告诉编码器这是屏幕内容（屏幕共享码控、不做降噪）
+    bool is_screencast() const override { return true; }
 
+    // 编码端的对齐要求（broadcaster 对所有 sink 取最小公倍数）缓存下来，转换线程每帧读取不用加锁
     void AddOrUpdateSink(webrtc::VideoSinkInterface<webrtc::VideoFrame> *sink,
                          const webrtc::VideoSinkWants &wants) override
     {
         broadcaster_.AddOrUpdateSink(sink, wants);
+        sink_alignment_.store(broadcaster_.wants().resolution_alignment);
     }
 
     void RemoveSink(webrtc::VideoSinkInterface<webrtc::VideoFrame> *sink) override
     {
         broadcaster_.RemoveSink(sink);
+        sink_alignment_.store(broadcaster_.wants().resolution_alignment);
     }
 
 private:
     void StartCaptureLoop(int target_fps, bool capture_cursor);
 
+    struct CapturedFrame
+    {
+        std::unique_ptr<webrtc::SharedDesktopFrame> frame;
+        int64_t capture_start_us{0}; // CaptureFrame 开始（或采集器回调 OnFrameCaptureStart）的时刻
+    };
+
+    // 采集线程：把帧交给转换线程，转换线程还没取走的旧帧被丢弃
+    void SubmitForConversion(CapturedFrame frame);
+    // 采集线程：CaptureFrame 之前调用，保证采集器复用缓冲时转换线程没有在读它
+    void WaitForConversionSlot();
+    void ConvertLoop();
+    void ConvertFrame(const webrtc::DesktopFrame &frame, int64_t capture_start_us);
+    void BroadcastLoop();
+    // 结束所有阶段（不等待），任意线程可调用
+    void ClosePipeline();
+    void JoinPipeline();
+    // 需持 full_chroma_mutex_ 调用
+    void UpdateFullChromaLocked();
+
+    void DetectContent(const webrtc::DesktopFrame &frame, int64_t now_ms);
+    void DumpFrame(const webrtc::DesktopFrame &frame, int64_t capture_time_us);
+
     std::unique_ptr<webrtc::DesktopCapturer> capturer_;
     std::atomic<bool> running_;
     std::thread cap_thread_;
     webrtc::VideoBroadcaster broadcaster_;
 
+    std::mutex content_mutex_;
+    std::condition_variable content_dispatch_done_;
+    int content_dispatching_{0}; // 正在锁外回调的次数，受 content_mutex_ 保护
+    std::unique_ptr<ContentMotionDetector> motion_detector_;
+    std::vector<std::pair<const void *, std::function<void(ContentMode)>>> content_callbacks_;
+    std::atomic<int64_t> capture_cpu_us_{0};
+
+    // 采集 -> 转换 -> 分发三个线程，之间用无锁的 LatestFrameQueue 交接，下游慢时丢旧帧而不是拖慢采集。
+    // 采集线程只把 DesktopFrame 包成 SharedDesktopFrame（不拷贝像素）交给转换线程。
+    // 采集器内部用两个缓冲的 ScreenCaptureFrameQueue 轮换，下一次 CaptureFrame 之前最多只能持有一帧，
+    // frames_held_ 统计已交出、还没释放的采集帧，达到 2 时采集线程等转换线程放掉正在读的那一帧。
+    std::thread convert_thread_;
+    std::thread broadcast_thread_;
+    LatestFrameQueue<CapturedFrame> convert_queue_;
+    LatestFrameQueue<webrtc::VideoFrame> broadcast_queue_;
+    std::atomic<int> frames_held_{0};
+    // I420 缓冲复用，只在转换线程使用；编码器还持有的缓冲不会被复用
+    webrtc::VideoFrameBufferPool buffer_pool_{false, 16};
+    std::atomic<int64_t> convert_cpu_us_{0};
+
+    // 时间统计，分别只在转换线程/分发线程写
+    std::atomic<double> capture_to_convert_ms_{0};
+    std::atomic<double> convert_ms_{0};
+    int resolution_alignment_{2};        // CaptureSourceConfig::resolution_alignment
+    std::atomic<int> sink_alignment_{1}; // VideoSinkWants::resolution_alignment
+    std::mutex full_chroma_mutex_;
+    std::map<const void *, bool> full_chroma_owners_;
+    std::atomic<bool> full_chroma_{false};
+    std::atomic<int> output_width_{0};
+    std::atomic<int> output_height_{0};
+    // 隐私遮挡，桌面坐标
+    std::mutex mask_mutex_;
+    std::vector<webrtc::DesktopRect> mask_rects_;
+    std::vector<webrtc::DesktopRect> window_mask_rects_; // 由 window_tracker_ 更新
+    std::unique_ptr<WindowMaskTracker> window_tracker_;
+    std::atomic<int> mask_count_{0};
+    std::atomic<double> mask_ms_{0};
+    std::atomic<double> capture_to_deliver_ms_{0};
+    std::atomic<double> timestamp_jitter_ms_{0};
+    // 只在采集线程写
+    std::atomic<double> grab_ms_{0};
+    std::atomic<double> last_grab_ms_{0};
+    std::atomic<uint64_t> slow_path_frames_{0};
+    CaptureBackendInfo backend_;
+    int64_t last_timestamp_us_{0};
+    int64_t last_timestamp_delta_us_{-1};
+
+    std::mutex dump_mutex_;
+    std::unique_ptr<CaptureDumpWriter> dump_writer_;
+
     int m_iTargetFps{25};
+    // 回放采集器自己控制节奏（按录制间隔或不限速），采集循环不再按 fps 睡眠
+    bool self_paced_{false};
 
     // 实现 VideoTrackSource 的纯虚函数 source()
 public:
@@ -154,10 +337,7 @@ class PeerObserver : public webrtc::PeerConnectionObserver
 {
 public:
     PeerObserver(SimpleSignaling *sig, WebRTCPushClient* owner) : signaling_(sig), owner_(owner) {}
-    void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) override
-    {
-        RTC_LOG(LS_INFO) << "Signaling state: " << new_state;
-    }
+    void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) override;
     void OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state) override;
     
     void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) override
@@ -170,7 +350,8 @@ public:
         candidate->ToString(&s);
         if (signaling_ && signaling_->onLocalIce)
             signaling_->onLocalIce(s);
-        RTC_LOG(LS_INFO) << "Local ICE: " << s;
+        // 每个候选都会触发，只在 VERBOSE 级别输出
+        RTC_LOG(LS_VERBOSE) << "Local ICE: " << s;
     }
     void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) override
     {
@@ -191,11 +372,22 @@ public:
     WebRTCPushClient(std::string id);
     ~WebRTCPushClient();
     std::string getId() const { return id; }
-    // 初始化 PeerConnectionFactory 与 PeerConnection
+    // 初始化 PeerConnectionFactory 与 PeerConnection，并立即开始推流（Prepare + Activate）
     bool Init(const std::vector<IceServerConfig> &ice_servers);
+    // 预热：创建 factory/PeerConnection、挂上视频轨并提前收集 ICE 候选，但不开始采集、不发 Offer
+    bool Prepare(const std::vector<IceServerConfig> &ice_servers);
+    // 分配给观看端：开始采集并发送 Offer，从这一刻开始计算加入到首帧的耗时
+    bool Activate(const std::string &viewer_id);
+    // Activate 到首帧编码完成的耗时（毫秒），-1 表示还没有首帧
+    int64_t JoinToFirstFrameMs() const { return first_frame_latency_ms_.load(); }
 
-    // 添加桌面捕获视频轨并设置编码参数
+    // Init 之前调用：设置帧率/码率/simulcast 分层
+    void SetVideoSendConfig(const VideoSendConfig &config) { video_config_ = config; }
+
+    // 添加桌面捕获视频轨并设置编码参数（采集在 Activate 时才开始）
     bool AddDesktopVideo(int fps = 30, int max_bitrate_bps = 3'000'000);
+    // simulcast 时通过 send_encodings 一次性配置所有层，同一路采集由编码器内部缩放
+    bool AddDesktopVideo(const VideoSendConfig &config);
 
     // 生成并发送 Offer（通过 SimpleSignaling 回调打印）
     bool CreateAndSendOffer(bool ice_restart = false);
@@ -206,9 +398,58 @@ public:
     // 注入远端 ICE 候选（字符串形式）
     bool AddRemoteIce(const std::string &candidate_sdp, int sdp_mline_index = 0, const std::string &sdp_mid = "video");
 
-    // 调整码率（在连接后可动态调用）
+    // 调整码率上限（在连接后可动态调用）；simulcast 时按原有比例分配到各层，
+    // 开启自适应码率时作为控制器的上限
     bool SetMaxBitrate(int bps);
 
+    // 调整 SVC 模式（如 "L1T3"），空字符串表示关闭分层；需要协商到的编码器支持该模式
+    bool SetScalabilityMode(const std::string &mode);
+
+    // 按 codec 名称（如 {"VP9", "H264"}）重排 transceiver 的编码器顺序，未列出的 codec 保持原顺序排在后面。
+    // AddDesktopVideo 之后、CreateAndSendOffer 之前调用；连接后调用需要重新协商才生效
+    bool SetCodecPreferences(const std::vector<std::string> &codec_names);
+
+    // Offer/Answer 完成（signaling 回到 stable）后检查协商到的发送 codec，是 4:4:4 时让采集源输出 I444
+    void OnNegotiationComplete();
+
+    // 切换屏幕内容模式（运行时、任意线程可调用，在 signaling 线程执行）：设置 track content hint 和 sender degradation preference
+    bool SetContentMode(ContentMode mode);
+    // 任意线程可调用（读的是随指标一起更新的副本）
+    ContentMode GetContentMode() const
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        return metrics_.content_mode;
+    }
+
+    // 自动内容检测的回调：切换内容模式，并按模式调整各层帧率上限和分辨率
+    void OnContentClassified(ContentMode mode);
+    // 统计回调：交给码率控制器，限制变化时重新下发编码参数
+    void OnNetworkSample(const NetworkSample &sample);
+    // 由配置、码率上限、内容模式和码率控制器共同计算各层的码率/帧率/缩放并下发（signaling 线程）
+    bool ApplyEncodingLimits();
+
+    // 最近一个统计周期的编码指标（需要 StartRtpSendStatsPolling 在运行）
+    VideoSendMetrics GetVideoSendMetrics() const;
+
+    // 观看端重要性，CPU 超预算时 priority 小的先降级
+    void SetPriority(int priority) { priority_.store(priority); }
+    int GetPriority() const { return priority_.load(); }
+    // CPU 降级等级（0 为不降级），由 CpuBudgetGovernor 调整：奇数级降帧率，偶数级降分辨率
+    void SetCpuDegradationLevel(int level);
+    int GetCpuDegradationLevel() const { return cpu_degradation_level_.load(); }
+    // 共用编码器时帧率/分辨率由配置决定，CPU 降级对该观看端不生效
+    bool SharesEncoder() const { return shared_source_; }
+    int64_t CaptureCpuMicros() const { return video_source_ ? video_source_->CaptureCpuMicros() : 0; }
+    CapturePipelineStats GetCapturePipelineStats() const
+    {
+        return video_source_ ? video_source_->GetPipelineStats() : CapturePipelineStats{};
+    }
+
+    // 录制编码后的帧到 IVF 文件（不额外编码）；配置了 record_dir 时 Activate 会自动开始。
+    // 没有预先挂上录制器时会重建发送流（触发一次关键帧）
+    bool StartRecording(const std::string &path);
+    void StopRecording();
+
     // 诊断：轮询 getStats 判断是否在发送 RTP（outbound-rtp bytesSent 是否增长）
     void StartRtpSendStatsPolling(int interval_ms = 1000);
     void StopRtpSendStatsPolling();
@@ -220,14 +461,31 @@ private:
     webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc_;
     webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory_;
     webrtc::scoped_refptr<webrtc::VideoTrackInterface> video_track_;
+    webrtc::scoped_refptr<CapturerTrackSource> video_source_;
     webrtc::scoped_refptr<webrtc::RtpSenderInterface> video_sender_;
+    webrtc::scoped_refptr<webrtc::RtpTransceiverInterface> video_transceiver_;
 
     std::unique_ptr<PeerObserver> observer_;
 
     std::unique_ptr<webrtc::Thread> network_thread_;
     std::unique_ptr<webrtc::Thread> worker_thread_;
     std::unique_ptr<webrtc::Thread> signaling_thread_;
+    // 投递到 signaling 线程的任务在析构开始后不再执行
+    webrtc::scoped_refptr<webrtc::PendingTaskSafetyFlag> signaling_safety_{webrtc::PendingTaskSafetyFlag::CreateDetached()};
     std::string id{""};
+    VideoSendConfig video_config_{};
+    int max_bitrate_bps_{0};
+    std::unique_ptr<AdaptiveBitrateController> abr_;
+    bool shared_source_{false}; // video_source_ 来自 CapturerTrackSource::AcquireShared
+    webrtc::scoped_refptr<EncodedFrameRecorder> recorder_;
+    std::atomic<int> priority_{0};
+    std::atomic<int> cpu_degradation_level_{0};
+
+    // --- 加入耗时 ---
+    bool prepared_{false};
+    int64_t join_time_ms_{0};
+    std::atomic<int64_t> first_frame_latency_ms_{-1};
+    void OnFramesEncoded();
 
     // --- RTP 发送诊断 ---
     std::atomic<bool> stats_polling_{false};
@@ -236,4 +494,13 @@ private:
     std::atomic<uint64_t> last_video_bytes_sent_{0};
     std::atomic<uint64_t> last_video_packets_sent_{0};
     void PollRtpSendStatsOnce();
+
+    // --- 编码指标（统计回调线程写，其它线程读）---
+    mutable std::mutex metrics_mutex_;
+    VideoSendMetrics metrics_{};
+    uint32_t last_frames_encoded_{0};
+    double last_total_encode_time_s_{0};
+    uint64_t last_qp_sum_{0};
+    int64_t last_stats_time_ms_{0};
+    bool slow_path_warned_{false}; // 慢路径只告警一次，之后看 slow_path_frames
 };
\ No newline at end of file
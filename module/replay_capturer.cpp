@@ -0,0 +1,110 @@
+#include "replay_capturer.h"
+
+#include <chrono>
+#include <thread>
+
+#include "modules/desktop_capture/desktop_frame.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace
+{
+    // 指向转储文件映射的帧，持有 reader 保证映射在帧销毁前有效
+    class ReplayFrame : public webrtc::DesktopFrame
+    {
+    public:
+        ReplayFrame(std::shared_ptr<CaptureDumpReader> reader, const CaptureDumpReader::Frame &frame)
+            : webrtc::DesktopFrame(webrtc::DesktopSize(frame.header->width, frame.header->height),
+                                   frame.header->width * webrtc::DesktopFrame::kBytesPerPixel,
+                                   static_cast<webrtc::FourCC>(frame.header->pixel_format),
+                                   const_cast<uint8_t *>(frame.data), nullptr),
+              reader_(std::move(reader))
+        {
+        }
+
+    private:
+        std::shared_ptr<CaptureDumpReader> reader_;
+    };
+} // namespace
+
+std::unique_ptr<ReplayDesktopCapturer> ReplayDesktopCapturer::Create(const CaptureReplayConfig &config)
+{
+    auto reader = std::make_shared<CaptureDumpReader>();
+    if (!reader->Open(config.path))
+    {
+        RTC_LOG(LS_ERROR) << "[REPLAY] cannot open capture dump " << config.path;
+        return nullptr;
+    }
+    if (reader->frames().empty())
+    {
+        RTC_LOG(LS_ERROR) << "[REPLAY] " << config.path << " has no valid frames";
+        return nullptr;
+    }
+    RTC_LOG(LS_INFO) << "[REPLAY] " << config.path << ": " << reader->frames().size() << " frames, "
+                     << (config.realtime ? "realtime" : "as fast as possible") << (config.loop ? ", loop" : "");
+    return std::unique_ptr<ReplayDesktopCapturer>(new ReplayDesktopCapturer(config, std::move(reader)));
+}
+
+ReplayDesktopCapturer::ReplayDesktopCapturer(const CaptureReplayConfig &config,
+                                             std::shared_ptr<CaptureDumpReader> reader)
+    : config_(config), reader_(std::move(reader))
+{
+}
+
+void ReplayDesktopCapturer::Start(Callback *callback)
+{
+    callback_ = callback;
+    next_ = 0;
+    loop_offset_us_ = 0;
+    start_us_ = webrtc::TimeMicros();
+}
+
+void ReplayDesktopCapturer::CaptureFrame()
+{
+    const auto &frames = reader_->frames();
+    if (next_ >= frames.size())
+    {
+        if (!config_.loop)
+        {
+            callback_->OnCaptureResult(Result::ERROR_PERMANENT, nullptr);
+            return;
+        }
+        // 下一轮接在最后一帧之后一个平均帧间隔
+        const int64_t span = frames.back().header->capture_time_us - frames.front().header->capture_time_us;
+        loop_offset_us_ += span + (frames.size() > 1 ? span / static_cast<int64_t>(frames.size() - 1) : 0);
+        next_ = 0;
+    }
+
+    const CaptureDumpReader::Frame &frame = frames[next_++];
+    if (config_.realtime)
+    {
+        const int64_t due_us = start_us_ + loop_offset_us_ + frame.header->capture_time_us -
+                               frames.front().header->capture_time_us;
+        const int64_t wait_us = due_us - webrtc::TimeMicros();
+        if (wait_us > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+    }
+
+    callback_->OnFrameCaptureStart();
+    auto out = std::make_unique<ReplayFrame>(reader_, frame);
+    out->set_capture_time_ms(frame.header->capture_cost_ms);
+    webrtc::DesktopRegion *region = out->mutable_updated_region();
+    for (int i = 0; i < frame.header->rect_count && i < kCaptureDumpMaxRects; ++i)
+    {
+        const CaptureDumpRect &r = frame.header->rects[i];
+        region->AddRect(webrtc::DesktopRect::MakeLTRB(r.left, r.top, r.right, r.bottom));
+    }
+    frames_replayed_++;
+    callback_->OnCaptureResult(Result::SUCCESS, std::move(out));
+}
+
+bool ReplayDesktopCapturer::GetSourceList(SourceList *sources)
+{
+    sources->push_back({0, config_.path});
+    return true;
+}
+
+bool ReplayDesktopCapturer::SelectSource(SourceId id)
+{
+    return id == 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "modules/desktop_capture/desktop_capturer.h"
+#include "capture_dump.h"
+#include "video_send_config.h"
+
+// 回放 CaptureDumpWriter 录下的转储文件，代替真实屏幕采集，用于无桌面环境下对
+// 格式转换和编码做基准测试。帧数据直接指向 mmap 的文件内容，不拷贝；变化区域和
+// 采集耗时按录制时的值还原。
+// realtime 时 CaptureFrame 按录制时的帧间隔阻塞到该帧的时刻，否则立即返回下一帧。
+class ReplayDesktopCapturer : public webrtc::DesktopCapturer
+{
+public:
+    // 文件无法打开或没有有效帧时返回 nullptr
+    static std::unique_ptr<ReplayDesktopCapturer> Create(const CaptureReplayConfig &config);
+
+    void Start(Callback *callback) override;
+    void CaptureFrame() override;
+    bool GetSourceList(SourceList *sources) override;
+    bool SelectSource(SourceId id) override;
+
+    uint64_t frames_replayed() const { return frames_replayed_; }
+
+private:
+    ReplayDesktopCapturer(const CaptureReplayConfig &config, std::shared_ptr<CaptureDumpReader> reader);
+
+    const CaptureReplayConfig config_;
+    std::shared_ptr<CaptureDumpReader> reader_;
+    Callback *callback_{nullptr};
+    size_t next_{0};
+    int64_t start_us_{0};       // 回放开始时刻
+    int64_t loop_offset_us_{0}; // 循环回放时每一轮累加的录制时长
+    uint64_t frames_replayed_{0};
+};
@@ -0,0 +1,503 @@
+#include "shared_encoder.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "api/video_codecs/scalability_mode.h"
+#include "gop_cache.h"
+#include "modules/video_coding/include/video_error_codes.h"
+#include "rtc_base/logging.h"
+#include "rtc_base/time_utils.h"
+
+namespace
+{
+    // 决定能否共享的编码参数；码率不在其中，取订阅者中最低的
+    std::string MakeEncoderKey(const webrtc::SdpVideoFormat &format, const webrtc::VideoCodec &codec)
+    {
+        std::ostringstream key;
+        key << format.ToString() << "|" << codec.width << "x" << codec.height << "@" << codec.maxFramerate
+            << "|mode=" << static_cast<int>(codec.mode) << "|qp=" << codec.qpMax
+            << "|streams=" << static_cast<int>(codec.numberOfSimulcastStreams);
+        for (int i = 0; i < codec.numberOfSimulcastStreams; ++i)
+        {
+            const auto &s = codec.simulcastStream[i];
+            key << "," << s.width << "x" << s.height << (s.active ? "" : "-off");
+        }
+        if (auto svc = codec.GetScalabilityMode())
+            key << "|" << webrtc::ScalabilityModeToString(*svc);
+        return key.str();
+    }
+
+    bool IsKeyframeRequest(const std::vector<webrtc::VideoFrameType> *frame_types)
+    {
+        return frame_types && std::any_of(frame_types->begin(), frame_types->end(), [](webrtc::VideoFrameType t)
+                                          { return t == webrtc::VideoFrameType::kVideoFrameKey; });
+    }
+} // namespace
+
+// 一个实际运行的编码器及其订阅者，所有状态由 mutex_ 保护。
+// 真正的 Encode 不持锁（libvpx 会在 Encode 内同步回调 OnEncodedImage）。
+class SharedEncoderEntry : public webrtc::EncodedImageCallback
+{
+public:
+    SharedEncoderEntry(std::string key, std::unique_ptr<webrtc::VideoEncoder> encoder, size_t cache_max_bytes,
+                       size_t cache_max_frames, size_t replay_max_bytes, int max_framerate)
+        : key_(std::move(key)), encoder_(std::move(encoder)), cache_(cache_max_bytes, cache_max_frames),
+          replay_max_bytes_(replay_max_bytes),
+          frame_interval_us_(webrtc::kNumMicrosecsPerSec / std::max(1, max_framerate))
+    {
+    }
+
+    const std::string &key() const { return key_; }
+    size_t subscriber_count()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return subscribers_.size();
+    }
+    webrtc::VideoEncoder *encoder() { return encoder_.get(); }
+
+    void AddSubscriber(SharedVideoEncoder *owner, webrtc::EncodedImageCallback *callback)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 加入时刻算作最近一次 Encode，一直没送过帧的 driver 也会被接替
+        subscribers_.push_back({owner, callback});
+        subscribers_.back().last_encode_us = webrtc::TimeMicros();
+        if (!driver_)
+            driver_ = owner;
+    }
+
+    // 返回剩余订阅者数量
+    size_t RemoveSubscriber(SharedVideoEncoder *owner)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers_.erase(std::remove_if(subscribers_.begin(), subscribers_.end(), [owner](const Subscriber &s)
+                                          { return s.owner == owner; }),
+                           subscribers_.end());
+        // 码率最低的订阅者可能刚离开，下一帧重新计算
+        rates_dirty_ = true;
+        if (driver_ == owner)
+        {
+            // 由下一个订阅者接替送帧
+            driver_ = subscribers_.empty() ? nullptr : subscribers_.front().owner;
+            if (driver_)
+                RTC_LOG(LS_INFO) << "[SHARED-ENC] driver handover " << key_;
+        }
+        return subscribers_.size();
+    }
+
+    void SetCallback(SharedVideoEncoder *owner, webrtc::EncodedImageCallback *callback)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (Subscriber *s = Find(owner))
+            s->callback = callback;
+    }
+
+    bool IsDriver(SharedVideoEncoder *owner)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return driver_ == owner;
+    }
+
+    void SetRates(SharedVideoEncoder *owner, const webrtc::VideoEncoder::RateControlParameters &parameters)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (Subscriber *s = Find(owner))
+        {
+            s->rates = parameters;
+            rates_dirty_ = true;
+        }
+    }
+
+    webrtc::VideoEncoder::EncoderInfo encoder_info()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return encoder_info_;
+    }
+
+    int32_t Encode(SharedVideoEncoder *owner, const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types)
+    {
+        std::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+        bool force_key = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Subscriber *s = Find(owner);
+            if (!s)
+                return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+            const int64_t now_us = webrtc::TimeMicros();
+            s->last_encode_us = now_us;
+            if (driver_ != owner && s->rates && s->rates->bitrate.get_sum_bps() > 0 && DriverStalled(now_us))
+            {
+                // driver 的连接断开或码率为 0 时它的 VideoStreamEncoder 会暂停、不再调用 Encode，
+                // 由还在发送的订阅者接替，否则同一编码器的所有观看端都会卡住
+                RTC_LOG(LS_INFO) << "[SHARED-ENC] driver stalled, handover " << key_;
+                driver_ = owner;
+                rates_dirty_ = true;
+            }
+            if (!s->joined)
+            {
+                // 第一次 Encode：回调已注册，码率已设置，此时补发缓存的 GOP
+                s->joined = true;
+                if (!Replay(s))
+                    pending_keyframe_ = true;
+            }
+            else if (IsKeyframeRequest(frame_types))
+            {
+                // 订阅者丢包后的 PLI/FIR，所有人都会收到这个关键帧
+                pending_keyframe_ = true;
+            }
+            if (driver_ != owner)
+                return WEBRTC_VIDEO_CODEC_OK;
+
+            force_key = pending_keyframe_;
+            pending_keyframe_ = false;
+            if (rates_dirty_)
+            {
+                rates = LowestRates();
+                rates_dirty_ = false;
+            }
+        }
+
+        // 以下只在 driver 的编码线程执行，真正的编码器不会被并发访问
+        if (rates)
+            encoder_->SetRates(*rates);
+        std::vector<webrtc::VideoFrameType> types =
+            frame_types ? *frame_types : std::vector<webrtc::VideoFrameType>{webrtc::VideoFrameType::kVideoFrameDelta};
+        if (force_key)
+            std::fill(types.begin(), types.end(), webrtc::VideoFrameType::kVideoFrameKey);
+        const int32_t ret = encoder_->Encode(frame, &types);
+        RefreshEncoderInfo();
+        return ret;
+    }
+
+    void RefreshEncoderInfo()
+    {
+        webrtc::VideoEncoder::EncoderInfo info = encoder_->GetEncoderInfo();
+        std::lock_guard<std::mutex> lock(mutex_);
+        encoder_info_ = std::move(info);
+    }
+
+    // --- webrtc::EncodedImageCallback：真正的编码器输出 ---
+    Result OnEncodedImage(const webrtc::EncodedImage &image, const webrtc::CodecSpecificInfo *codec_info) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        encoded_any_ = true;
+        const uint64_t overflows = cache_.overflows();
+        cache_.OnEncodedImage(image, codec_info);
+        if (cache_.overflows() != overflows)
+        {
+            // 不会再有自然的关键帧，主动出一个，让之后加入的观看端重新能命中缓存
+            pending_keyframe_ = true;
+            RTC_LOG(LS_INFO) << "[SHARED-ENC] gop cache overflow, requesting keyframe for " << key_;
+        }
+        const bool gop_start = image.FrameType() == webrtc::VideoFrameType::kVideoFrameKey &&
+                               image.SpatialIndex().value_or(0) == 0;
+        Result result(Result::OK, image.RtpTimestamp());
+        for (auto &s : subscribers_)
+        {
+            // 没拿到 GOP 的订阅者从下一个关键帧开始接收
+            if (!s.started && s.joined && gop_start)
+            {
+                s.started = true;
+                rates_dirty_ = true;
+            }
+            if (!s.started || !s.callback)
+                continue;
+            Result r = s.callback->OnEncodedImage(image, codec_info);
+            if (s.owner == driver_)
+                result = r;
+        }
+        return result;
+    }
+
+    void OnDroppedFrame(DropReason reason) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (Subscriber *s = Find(driver_))
+        {
+            if (s->callback)
+                s->callback->OnDroppedFrame(reason);
+        }
+    }
+
+private:
+    struct Subscriber
+    {
+        SharedVideoEncoder *owner;
+        webrtc::EncodedImageCallback *callback;
+        bool joined{false};  // 已经处理过第一次 Encode
+        bool started{false}; // 已经从关键帧开始接收
+        int64_t last_encode_us{0};
+        std::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+    };
+
+    Subscriber *Find(SharedVideoEncoder *owner)
+    {
+        for (auto &s : subscribers_)
+        {
+            if (s.owner == owner)
+                return &s;
+        }
+        return nullptr;
+    }
+
+    // 需持锁调用；driver 暂停发送（码率为 0）或超过两个帧间隔没有调用 Encode
+    bool DriverStalled(int64_t now_us)
+    {
+        Subscriber *d = Find(driver_);
+        if (!d)
+            return true;
+        if (d->rates && d->rates->bitrate.get_sum_bps() == 0)
+            return true;
+        return now_us - d->last_encode_us > 2 * frame_interval_us_;
+    }
+
+    // 需持锁调用；共享的编码器不能超过任何一个订阅者的带宽，取目标码率最低的那组参数
+    std::optional<webrtc::VideoEncoder::RateControlParameters> LowestRates() const
+    {
+        const webrtc::VideoEncoder::RateControlParameters *lowest = nullptr;
+        for (const auto &s : subscribers_)
+        {
+            // 码率为 0 的是暂停发送（例如还没连上）的订阅者不参与；
+            // 还没开始接收的新订阅者带宽估计仍在爬升，也不拖累已有的观看端
+            if (!s.rates || s.rates->bitrate.get_sum_bps() == 0 || !s.started)
+                continue;
+            if (!lowest || s.rates->bitrate.get_sum_bps() < lowest->bitrate.get_sum_bps())
+                lowest = &*s.rates;
+        }
+        if (!lowest)
+        {
+            for (const auto &s : subscribers_)
+            {
+                if (s.owner == driver_ && s.rates)
+                    return s.rates;
+            }
+            return std::nullopt;
+        }
+        return *lowest;
+    }
+
+    // 需持锁调用；把缓存的 GOP 发给新订阅者，之后它直接跟实时流
+    bool Replay(Subscriber *s)
+    {
+        auto &hub = SharedEncoderHub::Instance();
+        std::vector<CachedEncodedFrame> gop;
+        if (cache_.bytes() > replay_max_bytes_)
+        {
+            // 新连接的带宽估计从起始值开始爬升，一次补发太多只会堆在 pacer 里，不如直接等新关键帧
+            hub.cache_misses_++;
+            RTC_LOG(LS_INFO) << "[SHARED-ENC] cached gop " << cache_.bytes() << " bytes exceeds replay budget "
+                             << replay_max_bytes_ << ", requesting keyframe for " << key_;
+            return false;
+        }
+        if (!s->callback || !cache_.Snapshot(&gop))
+        {
+            // 第一个订阅者本来就从编码器的第一个关键帧开始，不算未命中
+            if (encoded_any_)
+                hub.cache_misses_++;
+            return false;
+        }
+        for (const auto &f : gop)
+            s->callback->OnEncodedImage(f.image, f.codec_info ? &*f.codec_info : nullptr);
+        s->started = true;
+        rates_dirty_ = true;
+        hub.cache_hits_++;
+        hub.frames_replayed_ += gop.size();
+        RTC_LOG(LS_INFO) << "[SHARED-ENC] replayed " << gop.size() << " cached frames (" << cache_.bytes()
+                         << " bytes) to new subscriber of " << key_;
+        return true;
+    }
+
+    const std::string key_;
+    std::unique_ptr<webrtc::VideoEncoder> encoder_;
+
+    std::mutex mutex_;
+    std::vector<Subscriber> subscribers_;
+    SharedVideoEncoder *driver_{nullptr};
+    GopCache cache_;
+    const size_t replay_max_bytes_;
+    const int64_t frame_interval_us_;
+    bool pending_keyframe_{false};
+    bool rates_dirty_{false};
+    bool encoded_any_{false};
+    webrtc::VideoEncoder::EncoderInfo encoder_info_;
+
+    friend class SharedEncoderHub;
+};
+
+SharedEncoderHub &SharedEncoderHub::Instance()
+{
+    static SharedEncoderHub hub;
+    return hub;
+}
+
+void SharedEncoderHub::SetCacheLimits(size_t max_bytes, size_t max_frames, size_t replay_max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_max_bytes_ = max_bytes;
+    cache_max_frames_ = max_frames;
+    replay_max_bytes_ = replay_max_bytes;
+}
+
+SharedEncoderHub::Stats SharedEncoderHub::GetStats() const
+{
+    Stats stats;
+    stats.cache_hits = cache_hits_.load();
+    stats.cache_misses = cache_misses_.load();
+    stats.frames_replayed = frames_replayed_.load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.encoders = entries_.size();
+    for (const auto &[key, entry] : entries_)
+    {
+        std::lock_guard<std::mutex> entry_lock(entry->mutex_);
+        stats.subscribers += entry->subscribers_.size();
+    }
+    return stats;
+}
+
+std::shared_ptr<SharedEncoderEntry> SharedEncoderHub::Join(const std::string &key, SharedVideoEncoder *owner,
+                                                           webrtc::EncodedImageCallback *callback,
+                                                           std::unique_ptr<webrtc::VideoEncoder> *candidate,
+                                                           const webrtc::VideoCodec &codec,
+                                                           const webrtc::VideoEncoder::Settings &settings)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        if (!*candidate)
+            return nullptr;
+        const int ret = (*candidate)->InitEncode(&codec, settings);
+        if (ret != WEBRTC_VIDEO_CODEC_OK)
+        {
+            RTC_LOG(LS_ERROR) << "[SHARED-ENC] InitEncode failed (" << ret << ") for " << key;
+            return nullptr;
+        }
+        auto entry = std::make_shared<SharedEncoderEntry>(key, std::move(*candidate), cache_max_bytes_,
+                                                          cache_max_frames_, replay_max_bytes_,
+                                                          static_cast<int>(codec.maxFramerate));
+        entry->encoder()->RegisterEncodeCompleteCallback(entry.get());
+        entry->RefreshEncoderInfo();
+        it = entries_.emplace(key, std::move(entry)).first;
+        RTC_LOG(LS_INFO) << "[SHARED-ENC] new encoder " << key << " (" << entries_.size() << " running)";
+    }
+    it->second->AddSubscriber(owner, callback);
+    RTC_LOG(LS_INFO) << "[SHARED-ENC] " << key << " subscribers=" << it->second->subscriber_count();
+    return it->second;
+}
+
+void SharedEncoderHub::Leave(const std::shared_ptr<SharedEncoderEntry> &entry, SharedVideoEncoder *owner)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entry->RemoveSubscriber(owner) > 0)
+        return;
+    entry->encoder()->Release();
+    entries_.erase(entry->key());
+    RTC_LOG(LS_INFO) << "[SHARED-ENC] released encoder " << entry->key() << " (" << entries_.size() << " running)";
+}
+
+SharedVideoEncoder::SharedVideoEncoder(std::shared_ptr<webrtc::VideoEncoderFactory> factory,
+                                       const webrtc::Environment &env, const webrtc::SdpVideoFormat &format)
+    : factory_(std::move(factory)), env_(env), format_(format), own_(factory_->Create(env_, format_))
+{
+}
+
+SharedVideoEncoder::~SharedVideoEncoder()
+{
+    Release();
+}
+
+int SharedVideoEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
+                                   const webrtc::VideoEncoder::Settings &settings)
+{
+    // 重新配置（分辨率/分层变化）时换到对应的共享编码器
+    const std::string key = MakeEncoderKey(format_, *codec_settings);
+    if (entry_ && entry_->key() != key && entry_->subscriber_count() > 1)
+        RTC_LOG(LS_WARNING) << "[SHARED-ENC] subscriber split off " << entry_->key() << " -> " << key;
+    Release();
+    if (!own_)
+        own_ = factory_->Create(env_, format_);
+    entry_ = SharedEncoderHub::Instance().Join(key, this, callback_, &own_, *codec_settings, settings);
+    return entry_ ? WEBRTC_VIDEO_CODEC_OK : WEBRTC_VIDEO_CODEC_ERROR;
+}
+
+int32_t SharedVideoEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback)
+{
+    callback_ = callback;
+    if (entry_)
+        entry_->SetCallback(this, callback);
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t SharedVideoEncoder::Release()
+{
+    if (entry_)
+    {
+        SharedEncoderHub::Instance().Leave(entry_, this);
+        entry_.reset();
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t SharedVideoEncoder::Encode(const webrtc::VideoFrame &frame,
+                                   const std::vector<webrtc::VideoFrameType> *frame_types)
+{
+    if (!entry_)
+        return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+    return entry_->Encode(this, frame, frame_types);
+}
+
+void SharedVideoEncoder::SetRates(const RateControlParameters &parameters)
+{
+    if (entry_)
+        entry_->SetRates(this, parameters);
+}
+
+void SharedVideoEncoder::OnPacketLossRateUpdate(float packet_loss_rate)
+{
+    // 这些回调都在订阅者自己的编码线程，只有 driver 的转给编码器（与 Encode 同线程）
+    if (entry_ && entry_->IsDriver(this))
+        entry_->encoder()->OnPacketLossRateUpdate(packet_loss_rate);
+}
+
+void SharedVideoEncoder::OnRttUpdate(int64_t rtt_ms)
+{
+    if (entry_ && entry_->IsDriver(this))
+        entry_->encoder()->OnRttUpdate(rtt_ms);
+}
+
+void SharedVideoEncoder::OnLossNotification(const LossNotification &loss_notification)
+{
+    if (entry_ && entry_->IsDriver(this))
+        entry_->encoder()->OnLossNotification(loss_notification);
+}
+
+webrtc::VideoEncoder::EncoderInfo SharedVideoEncoder::GetEncoderInfo() const
+{
+    if (entry_)
+        return entry_->encoder_info();
+    return own_ ? own_->GetEncoderInfo() : EncoderInfo{};
+}
+
+SharedVideoEncoderFactory::SharedVideoEncoderFactory(std::unique_ptr<webrtc::VideoEncoderFactory> factory)
+    : factory_(std::move(factory))
+{
+}
+
+std::vector<webrtc::SdpVideoFormat> SharedVideoEncoderFactory::GetSupportedFormats() const
+{
+    return factory_->GetSupportedFormats();
+}
+
+webrtc::VideoEncoderFactory::CodecSupport SharedVideoEncoderFactory::QueryCodecSupport(
+    const webrtc::SdpVideoFormat &format, std::optional<std::string> scalability_mode) const
+{
+    return factory_->QueryCodecSupport(format, std::move(scalability_mode));
+}
+
+std::unique_ptr<webrtc::VideoEncoder> SharedVideoEncoderFactory::Create(const webrtc::Environment &env,
+                                                                        const webrtc::SdpVideoFormat &format)
+{
+    return std::make_unique<SharedVideoEncoder>(factory_, env, format);
+}
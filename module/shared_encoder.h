@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "api/environment/environment.h"
+#include "api/video_codecs/sdp_video_format.h"
+#include "api/video_codecs/video_encoder.h"
+#include "api/video_codecs/video_encoder_factory.h"
+
+class SharedEncoderEntry;
+class SharedVideoEncoder;
+
+// 编码器共享中心：codec、分辨率、帧率、分层都相同的编码器只保留一个实例，
+// 输出（EncodedImage）分发给所有订阅的 RtpSender（各自打包），CPU 随不同的层数而不是观看端数增长。
+// 开启缓存时每个实例保存最近一个 GOP，后加入的观看端先收到缓存的关键帧+增量帧，
+// 立即可以解码，然后接着跟实时流。
+class SharedEncoderHub
+{
+public:
+    struct Stats
+    {
+        uint64_t cache_hits{0};      // 加入时拿到了完整 GOP
+        uint64_t cache_misses{0};    // 加入时没有可用 GOP，只能等新的关键帧
+        uint64_t frames_replayed{0}; // 从缓存补发的帧数
+        size_t encoders{0};          // 当前实际运行的编码器数
+        size_t subscribers{0};       // 订阅这些编码器的 sender 数
+    };
+
+    static SharedEncoderHub &Instance();
+
+    // 每个编码器 GOP 缓存的上限，只影响之后创建的编码器；
+    // replay_max_bytes 为新观看端补发缓存的上限，GOP 更大时改为请求关键帧（新连接的带宽估计还在爬升）
+    void SetCacheLimits(size_t max_bytes, size_t max_frames, size_t replay_max_bytes);
+    Stats GetStats() const;
+
+private:
+    friend class SharedVideoEncoder;
+    friend class SharedEncoderEntry;
+
+    SharedEncoderHub() = default;
+
+    // 加入 key 对应的编码器；不存在时用 candidate 创建并 InitEncode，失败返回 nullptr
+    std::shared_ptr<SharedEncoderEntry> Join(const std::string &key, SharedVideoEncoder *owner,
+                                             webrtc::EncodedImageCallback *callback,
+                                             std::unique_ptr<webrtc::VideoEncoder> *candidate,
+                                             const webrtc::VideoCodec &codec,
+                                             const webrtc::VideoEncoder::Settings &settings);
+    void Leave(const std::shared_ptr<SharedEncoderEntry> &entry, SharedVideoEncoder *owner);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<SharedEncoderEntry>> entries_;
+    size_t cache_max_bytes_{8 * 1024 * 1024};
+    size_t cache_max_frames_{600};
+    size_t replay_max_bytes_{40 * 1024};
+
+    std::atomic<uint64_t> cache_hits_{0};
+    std::atomic<uint64_t> cache_misses_{0};
+    std::atomic<uint64_t> frames_replayed_{0};
+};
+
+// 每个 RtpSender 拿到的编码器。第一个加入的（driver）把采集帧送进真正的编码器，
+// 其他订阅者的 Encode 只处理关键帧请求；driver 离开、码率降到 0 或超过两个帧间隔没有送帧时，
+// 由下一个码率不为 0 的订阅者接替。
+// 码率取已开始接收的订阅者中最低的一组，只有编码参数完全一致的观看端才会共享；
+// 观看端因重新配置换到别的编码器时会打印 split off 日志。
+class SharedVideoEncoder : public webrtc::VideoEncoder
+{
+public:
+    SharedVideoEncoder(std::shared_ptr<webrtc::VideoEncoderFactory> factory, const webrtc::Environment &env,
+                       const webrtc::SdpVideoFormat &format);
+    ~SharedVideoEncoder() override;
+
+    int InitEncode(const webrtc::VideoCodec *codec_settings, const webrtc::VideoEncoder::Settings &settings) override;
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) override;
+    int32_t Release() override;
+    int32_t Encode(const webrtc::VideoFrame &frame, const std::vector<webrtc::VideoFrameType> *frame_types) override;
+    void SetRates(const RateControlParameters &parameters) override;
+    void OnPacketLossRateUpdate(float packet_loss_rate) override;
+    void OnRttUpdate(int64_t rtt_ms) override;
+    void OnLossNotification(const LossNotification &loss_notification) override;
+    EncoderInfo GetEncoderInfo() const override;
+
+private:
+    std::shared_ptr<webrtc::VideoEncoderFactory> factory_;
+    const webrtc::Environment env_;
+    const webrtc::SdpVideoFormat format_;
+    // 还没加入共享编码器时自己持有的实例，加入时可能被移交给共享中心
+    std::unique_ptr<webrtc::VideoEncoder> own_;
+    std::shared_ptr<SharedEncoderEntry> entry_;
+    webrtc::EncodedImageCallback *callback_{nullptr};
+};
+
+// 包装编码器工厂，创建出的编码器都经过 SharedEncoderHub
+class SharedVideoEncoderFactory : public webrtc::VideoEncoderFactory
+{
+public:
+    explicit SharedVideoEncoderFactory(std::unique_ptr<webrtc::VideoEncoderFactory> factory);
+
+    std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+    CodecSupport QueryCodecSupport(const webrtc::SdpVideoFormat &format,
+                                   std::optional<std::string> scalability_mode) const override;
+    std::unique_ptr<webrtc::VideoEncoder> Create(const webrtc::Environment &env,
+                                                 const webrtc::SdpVideoFormat &format) override;
+
+private:
+    std::shared_ptr<webrtc::VideoEncoderFactory> factory_;
+};
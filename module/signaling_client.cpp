@@ -1,7 +1,32 @@
 #include "signaling_client.h"
 
+#include <unistd.h>
+
+#include <QDateTime>
+#include <algorithm>
+#include <fstream>
 #include <nlohmann/json.hpp>
 
+#include "cpu_governor.h"
+
+namespace
+{
+    // 进程常驻内存（/proc/self/statm 第二列，单位页）
+    int64_t ProcessRssMb()
+    {
+        std::ifstream statm("/proc/self/statm");
+        int64_t size_pages = 0, rss_pages = 0;
+        if (!(statm >> size_pages >> rss_pages))
+            return 0;
+        return rss_pages * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+    }
+
+    std::vector<IceServerConfig> DefaultIceServers()
+    {
+        return {{"stun:stun.l.google.com:19302", "", ""}};
+    }
+} // namespace
+
 SignalingClient::SignalingClient(QObject *parent)
     : QObject(parent)
 {
@@ -9,11 +34,20 @@ SignalingClient::SignalingClient(QObject *parent)
     connect(&m_webSocket, &QWebSocket::textMessageReceived, this, &SignalingClient::onTextMessageReceived);
     connect(&m_webSocket, &QWebSocket::disconnected, this, &SignalingClient::onDisconnected);
 
+    connect(&m_admissionTimer, &QTimer::timeout, this, &SignalingClient::checkAdmissionTimeouts);
+    m_admissionTimer.start(1000);
+
     // setupCallbacks();
 }
 
 void SignalingClient::connectToServer(const QString &url)
 {
+    // 连上信令之前先把连接预热好，第一个观看端也能直接拿到
+    if (!m_pool)
+    {
+        m_pool = std::make_unique<PeerConnectionPool>(m_videoSendConfig, DefaultIceServers(),
+                                                      std::max(0, m_videoSendConfig.admission.prewarm_peers));
+    }
     qDebug() << "Connecting to signaling server:" << url;
     m_webSocket.open(QUrl(url));
 }
@@ -43,7 +77,7 @@ void SignalingClient::onTextMessageReceived(const QString &message)
     std::string sdp  = j.value("sdp", "");
     std::string id   = j.value("id", "");
 
-    printf("Remote SDP type: %s\n", type.c_str());
+    RTC_LOG(LS_INFO) << "Remote SDP type: " << type;
 
     // printf("Signaling message received: %s\n", message.toUtf8().constData());
     // QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
@@ -68,11 +102,12 @@ void SignalingClient::onTextMessageReceived(const QString &message)
     }
     else if (type == "request")
     {
-        clients[id] = std::make_shared<WebRTCPushClient>(id);
-        std::vector<IceServerConfig> iceServers = {
-            {"stun:stun.l.google.com:19302", "", ""}};
-        setupCallbacks(clients[id]);
-        clients[id]->Init(iceServers);
+        // 可选的观看端优先级，CPU 超预算时优先级低的先降级
+        handleRequest(id, j.value("priority", 0));
+    }
+    else if (type == "leave")
+    {
+        removePeer(id);
     }
     else if (type == "candidate")
     {
@@ -80,14 +115,211 @@ void SignalingClient::onTextMessageReceived(const QString &message)
         std::string sdpMid = j.value("sdpMid", "");
         int sdpMLineIndex = j.value("sdpMLineIndex", 0);
 
-        qDebug() << "Received Remote ICE";
+        RTC_LOG(LS_VERBOSE) << "Received Remote ICE";
         // 注意：AddRemoteIce 需要 sdpMid 等参数，之前的接口只留了 string
         // 你可能需要修改 WebRTCPushClient::AddRemoteIce 签名来接收更多参数
         // 这里假设只传 candidate 字符串，或者你修改底层接口适配
-        clients[id]->AddRemoteIce(candidate, sdpMLineIndex, sdpMid);
+        auto jt = clients.find(id);
+        if (jt != clients.end())
+        {
+            jt->second->AddRemoteIce(candidate, sdpMLineIndex, sdpMid);
+        }
     }
 }
 
+void SignalingClient::handleRequest(const std::string &id, int priority)
+{
+    if (clients.count(id))
+    {
+        RTC_LOG(LS_WARNING) << "Duplicate request from " << id << ", ignored";
+        return;
+    }
+    for (const auto &q : m_waiting)
+    {
+        if (q.id == id)
+            return;
+    }
+
+    std::string reason;
+    if (!hasResourceBudget(&reason))
+    {
+        sendBusy(id, reason);
+        return;
+    }
+    if (m_waiting.empty() && canStartPeer())
+    {
+        startPeer(id, priority);
+        return;
+    }
+
+    const AdmissionConfig &admission = m_videoSendConfig.admission;
+    if (static_cast<int>(m_waiting.size()) >= admission.max_queued_requests)
+    {
+        sendBusy(id, "queue full");
+        return;
+    }
+    m_waiting.push_back({id, priority, QDateTime::currentMSecsSinceEpoch()});
+    RTC_LOG(LS_INFO) << "[ADMISSION] queued " << id << ", position " << m_waiting.size()
+                     << " (peers=" << clients.size() << ", negotiating=" << m_negotiating.size() << ")";
+
+    QJsonObject json;
+    json["type"] = "queued";
+    json["id"] = QString::fromStdString(id);
+    json["position"] = static_cast<int>(m_waiting.size());
+    sendJson(json);
+}
+
+bool SignalingClient::canStartPeer() const
+{
+    const AdmissionConfig &admission = m_videoSendConfig.admission;
+    return static_cast<int>(clients.size()) < admission.max_peers &&
+           static_cast<int>(m_negotiating.size()) < admission.max_pending_negotiations;
+}
+
+bool SignalingClient::hasResourceBudget(std::string *reason) const
+{
+    if (CpuBudgetGovernor::Instance().WouldExceedBudget())
+    {
+        *reason = "cpu";
+        return false;
+    }
+    const int max_rss_mb = m_videoSendConfig.admission.max_rss_mb;
+    if (max_rss_mb > 0)
+    {
+        // 按现有观看端的平均占用估算新观看端的内存
+        const int64_t rss_mb = ProcessRssMb();
+        const int64_t per_peer_mb = clients.empty() ? 0 : rss_mb / static_cast<int64_t>(clients.size());
+        if (rss_mb + per_peer_mb > max_rss_mb)
+        {
+            *reason = "memory";
+            return false;
+        }
+    }
+    return true;
+}
+
+void SignalingClient::startPeer(const std::string &id, int priority)
+{
+    RTC_LOG(LS_INFO) << "[ADMISSION] start " << id << " (peers=" << clients.size() + 1
+                     << ", negotiating=" << m_negotiating.size() + 1 << ")";
+    // 优先用预热好的连接，池为空时现场创建
+    std::shared_ptr<WebRTCPushClient> client = m_pool ? m_pool->Acquire() : nullptr;
+    const bool prewarmed = (client != nullptr);
+    if (!client)
+    {
+        client = std::make_shared<WebRTCPushClient>(id);
+        client->SetVideoSendConfig(m_videoSendConfig);
+    }
+    clients[id] = client;
+    m_negotiating[id] = QDateTime::currentMSecsSinceEpoch();
+
+    setupCallbacks(client);
+    client->SetPriority(priority);
+    const bool ok = prewarmed ? client->Activate(id) : client->Init(DefaultIceServers());
+    if (m_pool)
+    {
+        RTC_LOG(LS_INFO) << "[POOL] " << id << (prewarmed ? " uses pre-warmed connection" : " pool empty, cold start")
+                         << " (hits=" << m_pool->hits() << ", misses=" << m_pool->misses() << ")";
+    }
+    if (!ok)
+    {
+        RTC_LOG(LS_ERROR) << "[ADMISSION] init failed for " << id;
+        removePeer(id);
+        sendBusy(id, "init failed");
+    }
+}
+
+void SignalingClient::removePeer(const std::string &id)
+{
+    m_waiting.erase(std::remove_if(m_waiting.begin(), m_waiting.end(),
+                                   [&id](const QueuedRequest &q)
+                                   { return q.id == id; }),
+                    m_waiting.end());
+    m_negotiating.erase(id);
+    auto it = clients.find(id);
+    if (it == clients.end())
+        return;
+    // 先从表中移除再析构，析构期间的状态回调会找不到该 id 而直接忽略
+    auto client = std::move(it->second);
+    clients.erase(it);
+    client.reset();
+    RTC_LOG(LS_INFO) << "[ADMISSION] removed " << id << " (peers=" << clients.size() << ")";
+    pumpQueue();
+}
+
+void SignalingClient::onPeerConnectionState(const std::string &id,
+                                            webrtc::PeerConnectionInterface::PeerConnectionState state)
+{
+    using State = webrtc::PeerConnectionInterface::PeerConnectionState;
+    if (state == State::kConnected)
+    {
+        if (m_negotiating.erase(id))
+            pumpQueue();
+    }
+    else if (state == State::kFailed || state == State::kClosed)
+    {
+        removePeer(id);
+    }
+}
+
+void SignalingClient::pumpQueue()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    while (!m_waiting.empty() && canStartPeer())
+    {
+        QueuedRequest next = m_waiting.front();
+        m_waiting.pop_front();
+        if (now - next.enqueuedMs > m_videoSendConfig.admission.queue_timeout_ms)
+        {
+            sendBusy(next.id, "queue timeout");
+            continue;
+        }
+        std::string reason;
+        if (!hasResourceBudget(&reason))
+        {
+            sendBusy(next.id, reason);
+            continue;
+        }
+        startPeer(next.id, next.priority);
+    }
+}
+
+void SignalingClient::checkAdmissionTimeouts()
+{
+    const AdmissionConfig &admission = m_videoSendConfig.admission;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    std::vector<std::string> stalled;
+    for (const auto &[id, startMs] : m_negotiating)
+    {
+        if (now - startMs > admission.negotiation_timeout_ms)
+            stalled.push_back(id);
+    }
+    for (const auto &id : stalled)
+    {
+        RTC_LOG(LS_WARNING) << "[ADMISSION] negotiation timeout for " << id;
+        removePeer(id);
+    }
+
+    while (!m_waiting.empty() && now - m_waiting.front().enqueuedMs > admission.queue_timeout_ms)
+    {
+        sendBusy(m_waiting.front().id, "queue timeout");
+        m_waiting.pop_front();
+    }
+    pumpQueue();
+}
+
+void SignalingClient::sendBusy(const std::string &id, const std::string &reason)
+{
+    RTC_LOG(LS_WARNING) << "[ADMISSION] busy " << id << ": " << reason << " (peers=" << clients.size()
+                        << ", negotiating=" << m_negotiating.size() << ", queued=" << m_waiting.size() << ")";
+    QJsonObject json;
+    json["type"] = "busy";
+    json["id"] = QString::fromStdString(id);
+    json["reason"] = QString::fromStdString(reason);
+    sendJson(json);
+}
+
 void SignalingClient::onDisconnected()
 {
     qDebug() << "Signaling disconnected!";
@@ -121,6 +353,14 @@ void SignalingClient::setupCallbacks(std::shared_ptr<WebRTCPushClient> rtcClient
         QMetaObject::invokeMethod(this, [this, json]()
                                   { sendJson(json); });
     };
+
+    // 3. 连接状态变化转到主线程，更新准入控制的计数
+    rtcClient->signaling.onConnectionState = [this](const std::string &id,
+                                                    webrtc::PeerConnectionInterface::PeerConnectionState state)
+    {
+        QMetaObject::invokeMethod(this, [this, id, state]()
+                                  { onPeerConnectionState(id, state); });
+    };
 }
 
 void SignalingClient::sendJson(const QJsonObject &json)
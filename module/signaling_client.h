@@ -7,10 +7,13 @@
 #include <QJsonValue>
 #include <QJsonArray>
 #include <QUrl>
+#include <QTimer>
+#include <deque>
 #include <string>
 #include <unordered_map>
 #include <memory>
 #include "pushclient.h"
+#include "peer_connection_pool.h"
 
 class SignalingClient : public QObject {
     Q_OBJECT
@@ -20,6 +23,8 @@ public:
     ~SignalingClient() = default;
     // 连接信令服务器
     void connectToServer(const QString& url);
+    // 之后新建的每个推流客户端都使用该视频配置
+    void setVideoSendConfig(const VideoSendConfig& config) { m_videoSendConfig = config; }
 
 private slots:
     void onConnected();
@@ -33,8 +38,37 @@ private:
     // 发送 JSON 辅助函数
     void sendJson(const QJsonObject& json);
 
+    // --- 准入控制 ---
+    struct QueuedRequest
+    {
+        std::string id;
+        int priority;
+        qint64 enqueuedMs;
+    };
+    // 新观看端请求：资源不足回复 busy，有空位直接开始协商，否则排队
+    void handleRequest(const std::string& id, int priority);
+    // 观看端数和协商中的数量都未到上限
+    bool canStartPeer() const;
+    // CPU/内存预算能否再容纳一个观看端，不能时 reason 给出原因
+    bool hasResourceBudget(std::string* reason) const;
+    void startPeer(const std::string& id, int priority);
+    void removePeer(const std::string& id);
+    void onPeerConnectionState(const std::string& id, webrtc::PeerConnectionInterface::PeerConnectionState state);
+    // 有空位时按先后顺序从等待队列中取出请求
+    void pumpQueue();
+    // 定时检查排队超时和协商超时
+    void checkAdmissionTimeouts();
+    void sendBusy(const std::string& id, const std::string& reason);
+
     QWebSocket m_webSocket;
     // WebRTCPushClient* m_rtcClient;
 
     std::unordered_map<std::string, std::shared_ptr<WebRTCPushClient>> clients{};
+    VideoSendConfig m_videoSendConfig{};
+
+    std::unordered_map<std::string, qint64> m_negotiating{}; // id -> 开始协商的时间
+    std::deque<QueuedRequest> m_waiting{};
+    QTimer m_admissionTimer;
+    // connectToServer 时按当前视频配置创建
+    std::unique_ptr<PeerConnectionPool> m_pool;
 };
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include "video_send_config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include <nlohmann/json.hpp>
+
+#include "api/video_codecs/scalability_mode_helper.h"
+#include "rtc_base/logging.h"
+
+const char *ContentModeToString(ContentMode mode)
+{
+    switch (mode)
+    {
+    case ContentMode::kText:
+        return "text";
+    case ContentMode::kDetailed:
+        return "detailed";
+    case ContentMode::kFluid:
+        return "fluid";
+    }
+    return "unknown";
+}
+
+bool ContentModeFromString(const std::string &name, ContentMode *out)
+{
+    for (ContentMode mode : {ContentMode::kText, ContentMode::kDetailed, ContentMode::kFluid})
+    {
+        if (name == ContentModeToString(mode))
+        {
+            *out = mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+BitratePolicy BitratePolicy::Conservative()
+{
+    BitratePolicy p;
+    p.name = "conservative";
+    p.high_loss = 0.05;
+    p.low_loss = 0.01;
+    p.high_rtt_ms = 250;
+    p.decrease_factor = 0.6;
+    p.increase_factor = 1.05;
+    p.headroom = 0.75;
+    return p;
+}
+
+BitratePolicy BitratePolicy::Balanced()
+{
+    return BitratePolicy{};
+}
+
+BitratePolicy BitratePolicy::Aggressive()
+{
+    BitratePolicy p;
+    p.name = "aggressive";
+    p.high_loss = 0.12;
+    p.low_loss = 0.04;
+    p.high_rtt_ms = 600;
+    p.decrease_factor = 0.85;
+    p.increase_factor = 1.15;
+    p.headroom = 0.95;
+    return p;
+}
+
+BitratePolicy BitratePolicy::FromName(const std::string &name)
+{
+    if (name == "conservative")
+        return Conservative();
+    if (name == "aggressive")
+        return Aggressive();
+    return Balanced();
+}
+
+VideoSendConfig VideoSendConfig::DefaultSimulcast(int fps, int max_bitrate_bps)
+{
+    VideoSendConfig config;
+    config.fps = fps;
+    config.max_bitrate_bps = max_bitrate_bps;
+    config.simulcast_layers = {
+        {"f", 1.0, max_bitrate_bps * 4 / 7, fps, true},
+        {"h", 2.0, max_bitrate_bps * 2 / 7, fps, true},
+        {"q", 4.0, max_bitrate_bps / 7, std::max(1, fps / 2), true},
+    };
+    return config;
+}
+
+std::string PrivacyMaskConfig::Key() const
+{
+    std::string key;
+    for (const webrtc::DesktopRect &r : rects)
+        key += "|" + std::to_string(r.left()) + "," + std::to_string(r.top()) + "," + std::to_string(r.width()) + "," +
+               std::to_string(r.height());
+    for (const std::string &w : windows)
+        key += "|w:" + w;
+    return key;
+}
+
+std::string CaptureSourceConfig::Key() const
+{
+    return std::to_string(fps) + (capture_cursor ? "|cursor" : "|") + (detect_updated_region ? "|detect" : "|") +
+           (x11_damage ? "|damage" : "|") + "|" + backend + "|" + std::to_string(pipewire_node) + "|" + replay.path + (replay.realtime ? "|rt" : "|fast") +
+           (replay.loop ? "|loop" : "|once") + "|a" + std::to_string(resolution_alignment) +
+           privacy_mask.Key();
+}
+
+CaptureSourceConfig VideoSendConfig::CaptureSource() const
+{
+    CaptureSourceConfig source;
+    source.fps = fps;
+    source.detect_updated_region = auto_content_mode;
+    source.x11_damage = x11_damage;
+    source.backend = capture_backend;
+    source.pipewire_node = pipewire_node;
+    source.replay = replay;
+    source.privacy_mask = privacy_mask;
+    // simulcast 小层按整数倍缩小，采集尺寸再乘上最大的缩放倍数，小层也是对齐的
+    int scale = 1;
+    for (const SimulcastLayerConfig &layer : simulcast_layers)
+    {
+        if (layer.scale_resolution_down_by == std::floor(layer.scale_resolution_down_by))
+            scale = std::max(scale, static_cast<int>(layer.scale_resolution_down_by));
+    }
+    source.resolution_alignment = std::max(1, resolution_alignment) * scale;
+    return source;
+}
+
+std::vector<std::string> VideoSendConfig::EffectiveCodecPreferences() const
+{
+    if (!codec_preferences.empty() || scalability_mode.empty())
+        return codec_preferences;
+    return {"VP9", "AV1"};
+}
+
+std::vector<webrtc::RtpEncodingParameters> VideoSendConfig::ToSendEncodings() const
+{
+    std::optional<std::string> svc_mode;
+    if (!scalability_mode.empty())
+    {
+        auto spatial = webrtc::ScalabilityModeStringToNumSpatialLayers(scalability_mode);
+        if (!spatial)
+            RTC_LOG(LS_WARNING) << "Unknown scalability mode " << scalability_mode << ", ignored";
+        else if (*spatial > 1 && IsSimulcast())
+            RTC_LOG(LS_WARNING) << "Spatial SVC " << scalability_mode << " cannot be combined with simulcast, ignored";
+        else
+            svc_mode = scalability_mode;
+    }
+
+    std::vector<webrtc::RtpEncodingParameters> encodings;
+    if (!IsSimulcast())
+    {
+        webrtc::RtpEncodingParameters enc;
+        if (max_bitrate_bps > 0)
+            enc.max_bitrate_bps = max_bitrate_bps;
+        if (fps > 0)
+            enc.max_framerate = fps;
+        enc.scalability_mode = svc_mode;
+        encodings.push_back(enc);
+        return encodings;
+    }
+
+    for (const auto &layer : simulcast_layers)
+    {
+        webrtc::RtpEncodingParameters enc;
+        enc.rid = layer.rid;
+        enc.active = layer.active;
+        enc.scale_resolution_down_by = std::max(1.0, layer.scale_resolution_down_by);
+        if (layer.max_bitrate_bps > 0)
+            enc.max_bitrate_bps = layer.max_bitrate_bps;
+        if (layer.max_framerate > 0)
+            enc.max_framerate = layer.max_framerate;
+        else if (fps > 0)
+            enc.max_framerate = fps;
+        enc.scalability_mode = svc_mode;
+        encodings.push_back(enc);
+    }
+    return encodings;
+}
+
+bool ParseVideoSendConfig(const std::string &json_text, VideoSendConfig *out)
+{
+    VideoSendConfig config;
+    try
+    {
+        nlohmann::json j = nlohmann::json::parse(json_text);
+        if (!j.is_object())
+            return false;
+
+        config.fps = j.value("fps", config.fps);
+        config.max_bitrate_bps = j.value("max_bitrate_bps", config.max_bitrate_bps);
+
+        auto it = j.find("simulcast");
+        if (it != j.end() && it->is_boolean())
+        {
+            if (it->get<bool>())
+                config = VideoSendConfig::DefaultSimulcast(config.fps, config.max_bitrate_bps);
+        }
+        else if (it != j.end() && it->is_array())
+        {
+            for (const auto &l : *it)
+            {
+                if (!l.is_object())
+                    continue;
+                SimulcastLayerConfig layer;
+                layer.rid = l.value("rid", std::to_string(config.simulcast_layers.size()));
+                layer.scale_resolution_down_by = l.value("scale", 1.0);
+                layer.max_bitrate_bps = l.value("max_bitrate_bps", 0);
+                layer.max_framerate = l.value("max_fps", 0);
+                layer.active = l.value("active", true);
+                config.simulcast_layers.push_back(layer);
+            }
+        }
+
+        config.scalability_mode = j.value("scalability_mode", std::string{});
+        auto codecs = j.find("codecs");
+        if (codecs != j.end() && codecs->is_array())
+        {
+            for (const auto &c : *codecs)
+            {
+                if (c.is_string())
+                    config.codec_preferences.push_back(c.get<std::string>());
+            }
+        }
+
+        config.auto_content_mode = j.value("auto_content_mode", config.auto_content_mode);
+        config.text_max_fps = j.value("text_max_fps", config.text_max_fps);
+        config.fluid_scale_down_by = j.value("fluid_scale_down_by", config.fluid_scale_down_by);
+        config.shared_encoder = j.value("shared_encoder", config.shared_encoder);
+        auto cache = j.find("keyframe_cache");
+        if (cache != j.end() && cache->is_boolean())
+        {
+            config.keyframe_cache = cache->get<bool>();
+        }
+        else if (cache != j.end() && cache->is_object())
+        {
+            config.keyframe_cache = cache->value("enabled", true);
+            config.keyframe_cache_max_kb = cache->value("max_kb", config.keyframe_cache_max_kb);
+            config.keyframe_cache_max_frames = cache->value("max_frames", config.keyframe_cache_max_frames);
+            config.keyframe_cache_replay_max_kb = cache->value("replay_max_kb", config.keyframe_cache_replay_max_kb);
+        }
+        config.record_dir = j.value("record_dir", config.record_dir);
+        config.record_rid = j.value("record_rid", config.record_rid);
+        auto dump = j.find("capture_dump");
+        if (dump != j.end() && dump->is_string())
+        {
+            config.capture_dump_path = dump->get<std::string>();
+        }
+        else if (dump != j.end() && dump->is_object())
+        {
+            config.capture_dump_path = dump->value("path", config.capture_dump_path);
+            config.capture_dump_frames = dump->value("frames", config.capture_dump_frames);
+        }
+        auto replay = j.find("replay");
+        if (replay != j.end() && replay->is_string())
+        {
+            config.replay.path = replay->get<std::string>();
+        }
+        else if (replay != j.end() && replay->is_object())
+        {
+            config.replay.path = replay->value("path", config.replay.path);
+            config.replay.realtime = replay->value("realtime", config.replay.realtime);
+            config.replay.loop = replay->value("loop", config.replay.loop);
+        }
+        auto mask = j.find("privacy_mask");
+        if (mask != j.end() && mask->is_object())
+        {
+            PrivacyMaskConfig &m = config.privacy_mask;
+            auto rects = mask->find("rects");
+            if (rects != mask->end() && rects->is_array())
+            {
+                for (const auto &r : *rects)
+                {
+                    if (r.is_array() && r.size() == 4)
+                        m.rects.push_back(webrtc::DesktopRect::MakeXYWH(r[0].get<int>(), r[1].get<int>(),
+                                                                        r[2].get<int>(), r[3].get<int>()));
+                }
+            }
+            auto windows = mask->find("windows");
+            if (windows != mask->end() && windows->is_array())
+            {
+                for (const auto &w : *windows)
+                {
+                    if (w.is_string())
+                        m.windows.push_back(w.get<std::string>());
+                }
+            }
+            m.poll_ms = mask->value("poll_ms", m.poll_ms);
+        }
+        config.x11_damage = j.value("x11_damage", config.x11_damage);
+        auto backend = j.find("capture_backend");
+        if (backend != j.end() && backend->is_string())
+        {
+            config.capture_backend = backend->get<std::string>();
+        }
+        else if (backend != j.end() && backend->is_object())
+        {
+            config.capture_backend = backend->value("type", config.capture_backend);
+            config.pipewire_node = backend->value("node", config.pipewire_node);
+        }
+        config.cpu_budget_cores = j.value("cpu_budget_cores", config.cpu_budget_cores);
+        config.convert_isa = j.value("convert_isa", config.convert_isa);
+        config.full_chroma = j.value("full_chroma", config.full_chroma);
+        config.log_level = j.value("log_level", config.log_level);
+        config.log_rate_limit_per_sec = j.value("log_rate_limit_per_sec", config.log_rate_limit_per_sec);
+        config.resolution_alignment = j.value("resolution_alignment", config.resolution_alignment);
+        config.adaptive_bitrate = j.value("adaptive_bitrate", config.adaptive_bitrate);
+        auto policy = j.find("bitrate_policy");
+        if (policy != j.end() && policy->is_string())
+        {
+            config.bitrate_policy = BitratePolicy::FromName(policy->get<std::string>());
+        }
+        else if (policy != j.end() && policy->is_object())
+        {
+            BitratePolicy &p = config.bitrate_policy;
+            p = BitratePolicy::FromName(policy->value("preset", std::string{"balanced"}));
+            p.high_loss = policy->value("high_loss", p.high_loss);
+            p.low_loss = policy->value("low_loss", p.low_loss);
+            p.high_rtt_ms = policy->value("high_rtt_ms", p.high_rtt_ms);
+            p.decrease_factor = policy->value("decrease_factor", p.decrease_factor);
+            p.increase_factor = policy->value("increase_factor", p.increase_factor);
+            p.headroom = policy->value("headroom", p.headroom);
+            p.min_bitrate_bps = policy->value("min_bitrate_bps", p.min_bitrate_bps);
+            p.min_framerate = policy->value("min_framerate", p.min_framerate);
+            p.max_scale_down = policy->value("max_scale_down", p.max_scale_down);
+        }
+        auto admission = j.find("admission");
+        if (admission != j.end() && admission->is_object())
+        {
+            AdmissionConfig &a = config.admission;
+            a.max_peers = admission->value("max_peers", a.max_peers);
+            a.max_pending_negotiations = admission->value("max_pending_negotiations", a.max_pending_negotiations);
+            a.max_queued_requests = admission->value("max_queued_requests", a.max_queued_requests);
+            a.queue_timeout_ms = admission->value("queue_timeout_ms", a.queue_timeout_ms);
+            a.negotiation_timeout_ms = admission->value("negotiation_timeout_ms", a.negotiation_timeout_ms);
+            a.max_rss_mb = admission->value("max_rss_mb", a.max_rss_mb);
+            a.prewarm_peers = admission->value("prewarm_peers", a.prewarm_peers);
+        }
+        const std::string content_mode = j.value("content_mode", std::string{});
+        if (!content_mode.empty() && !ContentModeFromString(content_mode, &config.content_mode))
+            RTC_LOG(LS_WARNING) << "Unknown content_mode " << content_mode << ", using "
+                                << ContentModeToString(config.content_mode);
+    }
+    catch (const std::exception &e)
+    {
+        RTC_LOG(LS_ERROR) << "Video config parse failed: " << e.what();
+        return false;
+    }
+
+    *out = config;
+    return true;
+}
+
+bool LoadVideoSendConfig(const std::string &path, VideoSendConfig *out)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ParseVideoSendConfig(ss.str(), out);
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "api/rtp_parameters.h"
+#include "modules/desktop_capture/desktop_geometry.h"
+
+// 屏幕内容模式：决定 VideoTrack 的 content hint 和 RtpSender 的 degradation preference
+// kText/kDetailed 优先保持分辨率（降帧率），kFluid 优先保持帧率（降分辨率）
+enum class ContentMode
+{
+    kText,
+    kDetailed,
+    kFluid,
+};
+
+const char *ContentModeToString(ContentMode mode);
+// 接受 "text" / "detailed" / "fluid"，无法识别时返回 false
+bool ContentModeFromString(const std::string &name, ContentMode *out);
+
+// 码率调整策略，可以用预设或从配置中覆盖
+struct BitratePolicy
+{
+    std::string name{"balanced"};
+    double high_loss{0.08};        // 丢包率高于该值降码率
+    double low_loss{0.02};         // 丢包率低于该值才允许升码率
+    double high_rtt_ms{400};       // RTT 高于该值降码率
+    double decrease_factor{0.75};  // 每次降码率的倍数
+    double increase_factor{1.08};  // 每次升码率的倍数
+    double headroom{0.85};         // 最多使用 available_outgoing_bitrate 的比例
+    int min_bitrate_bps{150'000};
+    int min_framerate{5};
+    double max_scale_down{4.0};
+
+    static BitratePolicy Conservative();
+    static BitratePolicy Balanced();
+    static BitratePolicy Aggressive();
+    // "conservative" / "balanced" / "aggressive"，无法识别时返回 Balanced
+    static BitratePolicy FromName(const std::string &name);
+};
+
+// 观看端准入控制（SignalingClient 使用），超出上限的请求排队，排不下或资源不足时回复 busy
+struct AdmissionConfig
+{
+    int max_peers{8};                   // 同时推流的观看端上限
+    int max_pending_negotiations{2};    // 同时处于协商中（未连接）的观看端上限
+    int max_queued_requests{16};        // 等待队列长度
+    int queue_timeout_ms{15'000};       // 排队超过该时间回复 busy
+    int negotiation_timeout_ms{20'000}; // 协商超过该时间仍未连接则释放
+    int max_rss_mb{0};                  // 进程内存上限，预计超出时拒绝新观看端；0 表示不检查
+    int prewarm_peers{1};               // 预热连接池大小（不计入 max_peers），0 表示关闭
+};
+
+// 用录制的采集转储（CaptureDumpWriter）代替屏幕采集
+struct CaptureReplayConfig
+{
+    std::string path;   // 为空时使用真实屏幕采集
+    bool realtime{true}; // 按录制时的帧间隔回放；false 时尽可能快地回放（基准测试）
+    bool loop{true};     // 播完后从头循环
+};
+
+// 隐私遮挡：转换输出里涂黑的区域，采集端涂黑，观看端拿不到原始像素
+struct PrivacyMaskConfig
+{
+    std::vector<webrtc::DesktopRect> rects; // 固定区域，桌面坐标
+    // X11 下跟踪 WM_CLASS 或标题包含任一关键字（不区分大小写）的窗口，例如 "keepassxc"、"signal"
+    std::vector<std::string> windows;
+    int poll_ms{500}; // 窗口变化按事件更新，这是兜底扫描间隔（标题变化没有事件）
+
+    bool empty() const { return rects.empty() && windows.empty(); }
+    std::string Key() const;
+};
+
+// 采集源参数（CapturerTrackSource::Create / AcquireShared），完全相同的共享采集源才会复用
+struct CaptureSourceConfig
+{
+    int fps{30};
+    bool capture_cursor{true};
+    bool detect_updated_region{false}; // 让采集器给出准确的变化区域（内容运动检测需要）
+    bool x11_damage{false};            // X11 下用 XDamage 只读回变化区域（ScreenCapturerX11 的 use_update_notifications）
+    // "auto"：Wayland 会话用 PipeWire，否则 X11；"x11" / "pipewire" 强制指定
+    std::string backend{"auto"};
+    uint32_t pipewire_node{0}; // 非 0 时直连本机 PipeWire daemon 上的该节点（无桌面测试），否则走 xdg-desktop-portal
+    CaptureReplayConfig replay{};
+    // 输出宽高对齐的最小倍数，与编码端 VideoSinkWants::resolution_alignment 取最小公倍数后居中裁剪
+    int resolution_alignment{2};
+    PrivacyMaskConfig privacy_mask{};
+
+    std::string Key() const;
+};
+
+// 单个 simulcast 层的编码参数
+struct SimulcastLayerConfig
+{
+    std::string rid;                      // SDP 中的 rid，例如 "f" / "h" / "q"
+    double scale_resolution_down_by{1.0}; // 相对采集分辨率的缩放比例
+    int max_bitrate_bps{0};               // 0 表示不限制
+    int max_framerate{0};                 // 0 表示跟随采集帧率
+    bool active{true};
+};
+
+// 视频发送配置，在 WebRTCPushClient::Init 之前设置
+struct VideoSendConfig
+{
+    int fps{30};
+    int max_bitrate_bps{2'000'000};
+    // 为空表示单路编码；非空时通过 RtpTransceiverInit::send_encodings 开启 simulcast
+    std::vector<SimulcastLayerConfig> simulcast_layers;
+    // SVC 模式，例如 "L1T3"（仅时域分层）、"L3T3"（空域+时域，仅 VP9/AV1）；为空表示不分层。
+    // 时域分层可以和 simulcast 叠加（每层各自 L1Tx），空域分层只能用于单路编码。
+    std::string scalability_mode;
+    // 编码器偏好顺序（codec 名称，如 "VP9"、"AV1"、"H264"），为空时使用编码器工厂的默认顺序
+    std::vector<std::string> codec_preferences;
+    // 屏幕内容模式，运行时可通过 WebRTCPushClient::SetContentMode 切换
+    ContentMode content_mode{ContentMode::kDetailed};
+    // 根据屏幕变化面积自动在 text / fluid 之间切换，并调整帧率上限和分辨率
+    bool auto_content_mode{false};
+    int text_max_fps{10};            // text 模式下的帧率上限
+    double fluid_scale_down_by{1.5}; // fluid 模式下在各层原有缩放基础上再缩小的倍数
+    // 按 RTT/丢包/可用带宽调整每个观看端的码率、帧率和分辨率上限
+    bool adaptive_bitrate{true};
+    BitratePolicy bitrate_policy{};
+    // 编码参数相同的观看端共享一个采集源和编码器，CPU 随不同的层数而不是观看端数增长；
+    // 码率取这些观看端中最低的
+    bool shared_encoder{false};
+    // 共享编码器，并让后加入的观看端先收到缓存的最近一个 GOP（关键帧+增量帧）
+    bool keyframe_cache{false};
+    int keyframe_cache_max_kb{8 * 1024}; // 每个编码器的缓存上限，GOP 超出时作废直到下一个关键帧
+    int keyframe_cache_max_frames{600};
+    int keyframe_cache_replay_max_kb{40}; // 补发给新观看端的上限，约为起始码率（300 kbps）下 1 秒的数据量
+    // 非空时每个观看端的编码输出录制到 <record_dir>/<id>_<ms>.ivf；simulcast 时 record_rid 指定录哪一层
+    std::string record_dir;
+    std::string record_rid;
+    // 非空时把采集到的原始帧写入环形转储文件（只保留最近 capture_dump_frames 帧），用于回放复现
+    std::string capture_dump_path;
+    int capture_dump_frames{120};
+    CaptureReplayConfig replay{};
+    // X11 下用 XDamage 只读回变化区域；实际采集路径见 CapturerTrackSource::backend_info()
+    bool x11_damage{false};
+    std::string capture_backend{"auto"}; // 见 CaptureSourceConfig::backend
+    uint32_t pipewire_node{0};
+    // 进程级 CPU 预算（核数），> 0 时启动 CpuBudgetGovernor；对所有观看端生效
+    double cpu_budget_cores{0};
+    // 像素格式转换使用的指令集级别，见 InitConvertKernels；"auto" 使用检测到的全部特性
+    std::string convert_isa{"auto"};
+    // 全色度（4:4:4）：对端能解码且本地编码器支持 VP9 profile 1 / AV1 profile 1 时优先协商，
+    // 采集转换输出 I444，彩色文字不会被 4:2:0 色度下采样抹糊；协商不到时照常用 I420
+    bool full_chroma{false};
+    // 采集输出宽高对齐到的倍数（例如 16），奇数尺寸的屏幕/窗口裁掉边缘几个像素，编码器不需要补边和内部拷贝
+    int resolution_alignment{2};
+    PrivacyMaskConfig privacy_mask{};
+    // 日志级别（AsyncLogSink::SeverityFromString）和每个调用点每秒的条数上限，0 表示不限制；
+    // 只在启动时从本地配置读取，不接受信令消息修改（verbose 会输出完整 SDP/ICE）
+    std::string log_level{"info"};
+    int log_rate_limit_per_sec{20};
+    AdmissionConfig admission{};
+
+    // 全分辨率 / 1/2 / 1/4 三层，码率按 4:2:1 分配，小层帧率减半
+    static VideoSendConfig DefaultSimulcast(int fps, int max_bitrate_bps);
+
+    bool IsSimulcast() const { return simulcast_layers.size() > 1; }
+    bool SharesEncoder() const { return shared_encoder || keyframe_cache; }
+    // 配置了 SVC 但没有指定 codec 偏好时，优先协商支持 SVC 的 VP9/AV1
+    std::vector<std::string> EffectiveCodecPreferences() const;
+    // 推流客户端使用的采集源参数，自动内容模式需要变化区域
+    CaptureSourceConfig CaptureSource() const;
+
+    // 生成 AddTransceiver 用的 send_encodings
+    std::vector<webrtc::RtpEncodingParameters> ToSendEncodings() const;
+};
+
+// 从 JSON 文本解析配置，格式示例：
+// {
+//   "fps": 30, "max_bitrate_bps": 3000000,
+//   "simulcast": [
+//     {"rid": "f", "scale": 1, "max_bitrate_bps": 1700000, "max_fps": 30},
+//     {"rid": "h", "scale": 2, "max_bitrate_bps": 850000, "max_fps": 30},
+//     {"rid": "q", "scale": 4, "max_bitrate_bps": 450000, "max_fps": 15}
+//   ],
+//   "scalability_mode": "L1T3",
+//   "codecs": ["VP9", "AV1", "VP8"],
+//   "content_mode": "text",
+//   "auto_content_mode": true, "text_max_fps": 10, "fluid_scale_down_by": 1.5,
+//   "adaptive_bitrate": true,
+//   "bitrate_policy": "balanced",  // 或 {"preset": "conservative", "high_loss": 0.05, ...}
+//   "shared_encoder": true,
+//   "keyframe_cache": {"enabled": true, "max_kb": 8192, "max_frames": 600, "replay_max_kb": 40},  // 或 true
+//   "record_dir": "/tmp/rec", "record_rid": "f",
+//   "capture_dump": {"path": "/tmp/capture.cdmp", "frames": 120},  // 或 "/tmp/capture.cdmp"
+//   "replay": {"path": "/tmp/capture.cdmp", "realtime": false, "loop": true},  // 或 "/tmp/capture.cdmp"
+//   "x11_damage": true,
+//   "capture_backend": "auto",  // "x11" / "pipewire" 或 {"type": "pipewire", "node": 42}
+//   "cpu_budget_cores": 3.0,
+//   "full_chroma": true,
+//   "resolution_alignment": 16,
+//   "privacy_mask": {"rects": [[0, 0, 400, 300]], "windows": ["keepassxc", "signal"], "poll_ms": 500},
+//   "log_level": "warning", "log_rate_limit_per_sec": 20,
+//   "convert_isa": "avx2",  // "auto" / "c" / "sse2" / "ssse3" / "avx2" / "avx512" / "neon" / "sve"
+//   "admission": {"max_peers": 8, "max_pending_negotiations": 2, "max_queued_requests": 16,
+//                 "queue_timeout_ms": 15000, "negotiation_timeout_ms": 20000, "max_rss_mb": 2048,
+//                 "prewarm_peers": 1}
+// }
+// "simulcast": true 表示使用 DefaultSimulcast。解析失败返回 false，out 不变。
+bool ParseVideoSendConfig(const std::string &json_text, VideoSendConfig *out);
+// 读取文件并解析，文件不存在或格式错误返回 false
+bool LoadVideoSendConfig(const std::string &path, VideoSendConfig *out);
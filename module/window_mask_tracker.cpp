@@ -0,0 +1,268 @@
+#include "window_mask_tracker.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <optional>
+
+#include "modules/desktop_capture/linux/x11/window_list_utils.h"
+#include "modules/desktop_capture/linux/x11/x_atom_cache.h"
+#include "modules/desktop_capture/linux/x11/x_error_trap.h"
+#include "modules/desktop_capture/linux/x11/x_window_property.h"
+#include "rtc_base/logging.h"
+
+namespace
+{
+    std::string ToLower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    std::vector<std::string> LowerAll(std::vector<std::string> patterns)
+    {
+        for (std::string &p : patterns)
+            p = ToLower(p);
+        patterns.erase(std::remove(patterns.begin(), patterns.end(), std::string()), patterns.end());
+        return patterns;
+    }
+
+    // 窗口的 WM_CLASS（实例名和类名）和标题（优先 UTF-8 的 _NET_WM_NAME），拼在一起做匹配
+    std::string WindowText(Display *display, Window window, Atom net_wm_name)
+    {
+        std::string text;
+        XClassHint hint{};
+        if (XGetClassHint(display, window, &hint))
+        {
+            if (hint.res_name)
+            {
+                text += hint.res_name;
+                XFree(hint.res_name);
+            }
+            text += '\n';
+            if (hint.res_class)
+            {
+                text += hint.res_class;
+                XFree(hint.res_class);
+            }
+        }
+        text += '\n';
+        webrtc::XWindowProperty<uint8_t> name(display, window, net_wm_name);
+        if (name.is_valid() && name.size() > 0)
+        {
+            text.append(reinterpret_cast<const char *>(name.data()), name.size());
+        }
+        else
+        {
+            char *legacy = nullptr;
+            if (XFetchName(display, window, &legacy) && legacy)
+            {
+                text += legacy;
+                XFree(legacy);
+            }
+        }
+        return ToLower(text);
+    }
+} // namespace
+
+WindowMaskTracker::WindowMaskTracker(std::vector<std::string> patterns, int poll_ms, Callback callback)
+    : patterns_(LowerAll(std::move(patterns))), poll_ms_(std::max(100, poll_ms)), callback_(std::move(callback))
+{
+}
+
+WindowMaskTracker::~WindowMaskTracker()
+{
+    Stop();
+}
+
+bool WindowMaskTracker::Start()
+{
+    if (patterns_.empty() || running_.load())
+        return running_.load();
+    display_ = XOpenDisplay(nullptr);
+    if (!display_)
+    {
+        RTC_LOG(LS_WARNING) << "[PRIVACY] cannot open X display, masked windows will not be tracked";
+        return false;
+    }
+    atom_cache_ = std::make_unique<webrtc::XAtomCache>(display_);
+    net_wm_name_ = XInternAtom(display_, "_NET_WM_NAME", False);
+    // 顶层窗口（重排父窗口的 WM 下是边框窗口）的几何和映射变化都会发到根窗口
+    XSelectInput(display_, DefaultRootWindow(display_), SubstructureNotifyMask);
+    running_.store(true);
+    thread_ = std::thread(&WindowMaskTracker::Loop, this);
+    RTC_LOG(LS_INFO) << "[PRIVACY] tracking " << patterns_.size() << " window pattern(s), fallback scan every "
+                     << poll_ms_ << " ms";
+    return true;
+}
+
+void WindowMaskTracker::Stop()
+{
+    running_.store(false);
+    if (thread_.joinable())
+        thread_.join();
+    atom_cache_.reset();
+    if (display_)
+    {
+        XCloseDisplay(display_);
+        display_ = nullptr;
+    }
+}
+
+void WindowMaskTracker::Loop()
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto kWaitStep = std::chrono::milliseconds(50);
+    // 停止移动后旧位置再保留的时间
+    constexpr auto kSettle = std::chrono::milliseconds(200);
+    const auto poll_interval = std::chrono::milliseconds(poll_ms_);
+    const int fd = ConnectionNumber(display_);
+
+    bool rescan = true;
+    Clock::time_point last_scan;
+    std::optional<Clock::time_point> settle_deadline;
+    while (running_.load())
+    {
+        bool moved = false;
+        while (XPending(display_) > 0)
+        {
+            XEvent event;
+            XNextEvent(display_, &event);
+            switch (event.type)
+            {
+            case ConfigureNotify:
+            {
+                const XConfigureEvent &e = event.xconfigure;
+                moved |= OnConfigure(e.window, webrtc::DesktopRect::MakeXYWH(e.x, e.y, e.width, e.height));
+                break;
+            }
+            case MapNotify:
+            case UnmapNotify:
+            case DestroyNotify:
+            case ReparentNotify:
+                rescan = true;
+                break;
+            default:
+                break;
+            }
+        }
+
+        const auto now = Clock::now();
+        if (rescan || now - last_scan >= poll_interval)
+        {
+            rescan = false;
+            last_scan = now;
+            Scan();
+            moved = true;
+        }
+        if (moved)
+        {
+            std::vector<webrtc::DesktopRect> rects = CurrentRects();
+            const bool changed = rects.size() != last_rects_.size() ||
+                                 !std::equal(rects.begin(), rects.end(), last_rects_.begin(),
+                                             [](const webrtc::DesktopRect &a, const webrtc::DesktopRect &b)
+                                             { return a.equals(b); });
+            if (changed)
+            {
+                // 转换线程可能还在用旧矩形处理窗口已经移动后的帧，新旧位置一起遮挡
+                std::vector<webrtc::DesktopRect> masked = rects;
+                masked.insert(masked.end(), last_rects_.begin(), last_rects_.end());
+                last_rects_ = std::move(rects);
+                callback_(std::move(masked));
+                settle_deadline = now + kSettle;
+            }
+        }
+        if (settle_deadline && now >= *settle_deadline)
+        {
+            // 一段时间内没有再变化，只保留当前位置
+            settle_deadline.reset();
+            callback_(last_rects_);
+        }
+
+        // 等 X 事件，最多等一个步长，Stop 不用等太久
+        if (XPending(display_) == 0)
+        {
+            pollfd pfd{fd, POLLIN, 0};
+            poll(&pfd, 1, static_cast<int>(kWaitStep.count()));
+        }
+    }
+}
+
+void WindowMaskTracker::Scan()
+{
+    tracked_.clear();
+    // 枚举过程中窗口随时可能被关闭，忽略期间的 BadWindow
+    webrtc::XErrorTrap trap(display_);
+    webrtc::GetWindowList(atom_cache_.get(), [this](::Window window)
+                          {
+        webrtc::DesktopRect client;
+        if (!Matches(window) || !webrtc::GetWindowRect(display_, window, &client) || client.is_empty())
+            return true;
+        // 顶层窗口是根窗口的直接子窗口，x/y 与 ConfigureNotify 一样是根窗口坐标
+        const ::Window top_level = TopLevelOf(window);
+        XWindowAttributes attributes{};
+        webrtc::DesktopRect top_rect = client;
+        if (top_level != window && XGetWindowAttributes(display_, top_level, &attributes))
+            top_rect = webrtc::DesktopRectFromXAttributes(attributes);
+        tracked_[top_level] = {top_rect, client};
+        return true; });
+    trap.GetLastErrorAndDisable();
+}
+
+bool WindowMaskTracker::OnConfigure(unsigned long window, const webrtc::DesktopRect &rect)
+{
+    auto it = tracked_.find(window);
+    if (it == tracked_.end())
+        return false;
+    Tracked &t = it->second;
+    // 边框相对客户区的位置不变，客户区跟着平移，尺寸按同样的差值变化
+    const int dx = rect.left() - t.top_level.left();
+    const int dy = rect.top() - t.top_level.top();
+    const int dw = rect.width() - t.top_level.width();
+    const int dh = rect.height() - t.top_level.height();
+    t.client = webrtc::DesktopRect::MakeLTRB(t.client.left() + dx, t.client.top() + dy,
+                                             t.client.right() + dx + dw, t.client.bottom() + dy + dh);
+    t.top_level = rect;
+    return true;
+}
+
+std::vector<webrtc::DesktopRect> WindowMaskTracker::CurrentRects() const
+{
+    std::vector<webrtc::DesktopRect> rects;
+    for (const auto &[window, t] : tracked_)
+        if (!t.client.is_empty())
+            rects.push_back(t.client);
+    return rects;
+}
+
+unsigned long WindowMaskTracker::TopLevelOf(unsigned long window) const
+{
+    // 重排父窗口的 WM 会把应用窗口放进边框窗口，往上找到根窗口的直接子窗口
+    ::Window current = window;
+    while (true)
+    {
+        ::Window root = 0;
+        ::Window parent = 0;
+        ::Window *children = nullptr;
+        unsigned int count = 0;
+        if (!XQueryTree(display_, current, &root, &parent, &children, &count))
+            return current;
+        if (children)
+            XFree(children);
+        if (parent == 0 || parent == root)
+            return current;
+        current = parent;
+    }
+}
+
+bool WindowMaskTracker::Matches(unsigned long window) const
+{
+    const std::string text = WindowText(display_, window, net_wm_name_);
+    return std::any_of(patterns_.begin(), patterns_.end(), [&text](const std::string &p)
+                       { return text.find(p) != std::string::npos; });
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "modules/desktop_capture/desktop_geometry.h"
+
+struct _XDisplay;
+
+namespace webrtc
+{
+    class XAtomCache;
+}
+
+// 跟踪需要隐私遮挡的窗口位置（X11）：用 window_list_utils 枚举屏幕上的窗口，
+// WM_CLASS 或标题包含任一关键字（不区分大小写）的窗口矩形（桌面坐标）交给回调。
+// 后台线程在根窗口上监听 SubstructureNotify：匹配窗口所在顶层窗口（WM 的边框窗口）的 ConfigureNotify
+// 直接按事件里的几何更新矩形，不重新枚举；映射/取消映射/销毁/换父窗口时才完整扫描，
+// 标题变化没有对应事件，另外每 poll_ms 兜底扫描一次。匹配到的区域没有变化时不回调。
+// 移动过程中每次回调都是上一个位置和新位置的并集，停止移动一小段时间后只保留当前位置，
+// 覆盖窗口已经移动、但转换线程还没拿到新矩形时的那几帧。
+// Wayland 会话下只能看到 XWayland 窗口，原生 Wayland 窗口的位置拿不到，只能用固定区域遮挡。
+class WindowMaskTracker
+{
+public:
+    using Callback = std::function<void(std::vector<webrtc::DesktopRect>)>;
+
+    WindowMaskTracker(std::vector<std::string> patterns, int poll_ms, Callback callback);
+    ~WindowMaskTracker();
+
+    WindowMaskTracker(const WindowMaskTracker &) = delete;
+    WindowMaskTracker &operator=(const WindowMaskTracker &) = delete;
+
+    // 连不上 X server 时返回 false
+    bool Start();
+    // 等待线程退出，返回后不会再回调
+    void Stop();
+
+private:
+    // 匹配窗口及其顶层窗口的位置，顶层窗口移动/缩放时客户区按同样的偏移和尺寸变化更新
+    struct Tracked
+    {
+        webrtc::DesktopRect top_level;
+        webrtc::DesktopRect client;
+    };
+
+    void Loop();
+    // 重新枚举，重建 tracked_
+    void Scan();
+    // 顶层窗口的 ConfigureNotify，返回是否是跟踪中的窗口
+    bool OnConfigure(unsigned long window, const webrtc::DesktopRect &rect);
+    std::vector<webrtc::DesktopRect> CurrentRects() const;
+    unsigned long TopLevelOf(unsigned long window) const;
+    bool Matches(unsigned long window) const;
+
+    const std::vector<std::string> patterns_; // 已转成小写
+    const int poll_ms_;
+    const Callback callback_;
+    _XDisplay *display_{nullptr};
+    std::unique_ptr<webrtc::XAtomCache> atom_cache_;
+    unsigned long net_wm_name_{0}; // _NET_WM_NAME
+    std::map<unsigned long, Tracked> tracked_; // 顶层窗口 -> 位置，只在跟踪线程访问
+    std::vector<webrtc::DesktopRect> last_rects_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
@@ -0,0 +1,88 @@
+#include "x11_capture_probe.h"
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/Xdamage.h>
+
+#include "modules/desktop_capture/linux/x11/x_error_trap.h"
+#include "rtc_base/logging.h"
+
+namespace
+{
+    // 与 XServerPixelBuffer::InitShm 一样：建一个共享内存段并让 X server attach，
+    // 远程连接或 IPC 命名空间隔离时 attach 会失败
+    bool CanAttachShm(Display *display)
+    {
+        const int shmid = shmget(IPC_PRIVATE, 4096, IPC_CREAT | 0600);
+        if (shmid < 0)
+            return false;
+        void *addr = shmat(shmid, nullptr, 0);
+        bool attached = false;
+        if (addr != reinterpret_cast<void *>(-1))
+        {
+            XShmSegmentInfo info{};
+            info.shmid = shmid;
+            info.shmaddr = static_cast<char *>(addr);
+            info.readOnly = False;
+            webrtc::XErrorTrap trap(display);
+            attached = XShmAttach(display, &info);
+            XSync(display, False);
+            if (trap.GetLastErrorAndDisable() != 0)
+                attached = false;
+            if (attached)
+            {
+                XShmDetach(display, &info);
+                XSync(display, False);
+            }
+            shmdt(addr);
+        }
+        shmctl(shmid, IPC_RMID, nullptr);
+        return attached;
+    }
+
+    X11CaptureProbe DoProbe()
+    {
+        X11CaptureProbe probe;
+        Display *display = XOpenDisplay(nullptr);
+        if (!display)
+            return probe;
+        probe.display_ok = true;
+        probe.depth = DefaultDepth(display, DefaultScreen(display));
+
+        int major = 0, minor = 0;
+        Bool pixmaps = False;
+        if (XShmQueryVersion(display, &major, &minor, &pixmaps) && CanAttachShm(display))
+        {
+            probe.xshm = true;
+            probe.xshm_pixmaps = pixmaps && XShmPixmapFormat(display) == ZPixmap;
+        }
+        int event_base = 0, error_base = 0;
+        probe.xdamage = XDamageQueryExtension(display, &event_base, &error_base);
+        XCloseDisplay(display);
+
+        RTC_LOG(LS_INFO) << "[X11-PROBE] mode=" << probe.PixelBufferMode() << " xdamage=" << probe.xdamage
+                         << " depth=" << probe.depth;
+        if (probe.SlowPath())
+            RTC_LOG(LS_WARNING) << "[X11-PROBE] MIT-SHM unavailable, X11 capture falls back to XGetImage full reads";
+        return probe;
+    }
+} // namespace
+
+std::string X11CaptureProbe::PixelBufferMode() const
+{
+    if (!display_ok)
+        return "unavailable";
+    if (!xshm)
+        return "xgetimage";
+    return xshm_pixmaps ? "shm-pixmap" : "shm-getimage";
+}
+
+const X11CaptureProbe &ProbeX11Capture()
+{
+    static const X11CaptureProbe probe = DoProbe();
+    return probe;
+}
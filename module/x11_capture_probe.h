@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+
+// 探测 X server 上 ScreenCapturerX11 会走哪条采集路径。ScreenCapturerX11 不对外暴露这些状态，
+// 这里按它（XServerPixelBuffer）的选择逻辑在同一个 X server 上独立检查一遍：
+//   shm-pixmap   MIT-SHM + 共享内存 pixmap，XCopyArea 到共享内存，最快
+//   shm-getimage MIT-SHM 但不支持 pixmap，XShmGetImage
+//   xgetimage    没有 MIT-SHM 或无法 attach（远程 X、容器隔离 IPC），每帧 XGetImage 全量读回，CPU 高 5-10 倍
+// 结果在进程内缓存，只探测一次。
+struct X11CaptureProbe
+{
+    bool display_ok{false};   // 能连上 $DISPLAY
+    bool xshm{false};         // MIT-SHM 可用且共享内存段能 attach 到 X server
+    bool xshm_pixmaps{false}; // 支持 ZPixmap 格式的共享内存 pixmap
+    bool xdamage{false};      // XDamage 扩展可用（还需要开启 use_update_notifications 才会被使用）
+    int depth{0};             // 根窗口色深，ScreenCapturerX11 只支持 24/32
+
+    // "shm-pixmap" / "shm-getimage" / "xgetimage"，连不上 X 时为 "unavailable"
+    std::string PixelBufferMode() const;
+    // XGetImage 全量读回
+    bool SlowPath() const { return display_ok && !xshm; }
+};
+
+const X11CaptureProbe &ProbeX11Capture();
@@ -0,0 +1,48 @@
+// 在目标机器上测每个像素格式转换核在各指令集级别下的耗时（以及隐私遮挡的额外耗时），
+// 用于选择 video_config.json 里的 convert_isa
+//   convert_bench [width] [height] [frames]   默认 1920 1080 200
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include "module/frame_converter.h"
+
+int main(int argc, char *argv[])
+{
+    const int width = argc > 1 ? atoi(argv[1]) : 1920;
+    const int height = argc > 2 ? atoi(argv[2]) : 1080;
+    const int frames = argc > 3 ? atoi(argv[3]) : 200;
+    if (width <= 0 || height <= 0 || frames <= 0)
+    {
+        fprintf(stderr, "usage: convert_bench [width] [height] [frames]\n");
+        return 1;
+    }
+
+    InitConvertKernels();
+    printf("%dx%d, %d frames, isa levels:", width, height, frames);
+    for (const std::string &isa : AvailableConvertIsas())
+        printf(" %s", isa.c_str());
+    printf("\n\n%-6s %-6s %-8s %10s %10s %10s\n", "src", "dst", "isa", "ms/frame", "Mpix/s", "mask ms");
+
+    // 每个转换核最快的级别
+    std::map<std::string, ConvertBenchmarkResult> best;
+    for (const ConvertBenchmarkResult &r : RunConvertBenchmark(width, height, frames))
+    {
+        printf("%-6s %-6s %-8s %10.3f %10.1f %10.3f\n", SourceFormatName(r.src), DestFormatName(r.dst), r.isa.c_str(),
+               r.ms_per_frame, r.mpix_per_s, r.mask_ms_per_frame);
+        const std::string key = std::string(SourceFormatName(r.src)) + "->" + DestFormatName(r.dst);
+        auto it = best.find(key);
+        if (it == best.end() || r.ms_per_frame < it->second.ms_per_frame)
+            best[key] = r;
+    }
+
+    printf("\nfastest:\n");
+    for (const auto &[key, r] : best)
+        printf("  %-12s %-8s %.3f ms\n", key.c_str(), r.isa.c_str(), r.ms_per_frame);
+    // 推流默认走 BGRA -> I420
+    auto main_path = best.find("BGRA->I420");
+    if (main_path != best.end())
+        printf("\nsuggested: \"convert_isa\": \"%s\"\n", main_path->second.isa.c_str());
+    return 0;
+}
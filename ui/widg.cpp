@@ -8,6 +8,10 @@
 #include "api/field_trials.h"
 #include "rtc_base/thread.h"
 #include "rtc_base/logging.h"
+#include "module/codec_benchmark.h"
+#include "module/async_log_sink.h"
+#include "module/cpu_governor.h"
+#include "module/frame_converter.h"
 
 ABSL_FLAG(
     std::string,
@@ -33,6 +37,29 @@ widg::widg(QWidget *parent)
     //         field_trials_str));
 
     m_ptrSignalingClient = new SignalingClient(this);
+    // 可选的视频发送配置（simulcast 分层等），不存在时使用默认单路编码
+    VideoSendConfig videoConfig;
+    if (LoadVideoSendConfig("video_config.json", &videoConfig))
+    {
+        m_ptrSignalingClient->setVideoSendConfig(videoConfig);
+    }
+    webrtc::LoggingSeverity severity;
+    if (AsyncLogSink::SeverityFromString(videoConfig.log_level, &severity))
+        AsyncLogSink::Instance().SetMinSeverity(severity);
+    else
+        RTC_LOG(LS_WARNING) << "Unknown log_level " << videoConfig.log_level << ", keeping current level";
+    AsyncLogSink::Instance().SetRateLimitPerSecond(videoConfig.log_rate_limit_per_sec);
+    // 进程级 CPU 预算，超出时按观看端优先级降帧率/分辨率
+    CpuBudgetGovernor::Instance().Start(videoConfig.cpu_budget_cores);
+    // 在任何转换线程启动前确定 libyuv 的指令集级别
+    InitConvertKernels(videoConfig.convert_isa);
+    // 没有指定 codec 时，后台跑一次编码器基准，按屏幕内容下的 CPU/帧率选择默认 codec
+    if (videoConfig.EffectiveCodecPreferences().empty())
+    {
+        CodecBenchmarkOptions benchOptions;
+        benchOptions.target_fps = videoConfig.fps;
+        CodecBenchmark::StartInBackground(benchOptions);
+    }
     m_ptrSignalingClient->connectToServer("ws://localhost:8000/server");
 }
 